@@ -0,0 +1,15 @@
+// Generated by tools/parcel: the disc path of every packed asset and the
+// buffer size, in bytes, request_packed_asset() needs to read and unpack it.
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#define ASSET_BALL16C "\\ASSETS\\BALL16C.TLZ;1"
+#define ASSET_BALL16C_BUFFER_SIZE 2048
+
+#define ASSET_GAME_TITLE "\\ASSETS\\GAME_TIT.TLZ;1"
+#define ASSET_GAME_TITLE_BUFFER_SIZE 78616
+
+#define ASSET_MAIN_TEXTURE "\\ASSETS\\MAIN_TEX.TLZ;1"
+#define ASSET_MAIN_TEXTURE_BUFFER_SIZE 78592
+
+#endif // ASSETS_H
@@ -0,0 +1,176 @@
+/**
+ * @file asset_loader.c
+ * @brief Background loading of files from the CD
+ *
+ * Assets compiled into the executable are all loaded at boot and stay in RAM
+ * for good. Files on the disc (declared in iso.xml) are instead read when
+ * requested, while the game keeps running: request_asset() queues a read and
+ * update_asset_loader(), called once per frame, polls the drive, starts the
+ * next read as soon as one completes and runs the completion callbacks.
+ *
+ * Callbacks run from update_asset_loader(), not from an interrupt, so they
+ * can do anything the main loop can, like uploading a TIM with
+ * vram_load_tim(). Buffers are owned by the caller and must stay untouched
+ * until their callback ran.
+ *
+ * Looking a file up in the directory is still blocking (CdSearchFile()), the
+ * sector reads are not.
+ *
+ * Packed files (request_packed_asset(), made by tools/lzpack) are read into
+ * the end of the buffer and unpacked in place to its start, so the callback
+ * gets the original file without a second buffer. The buffer size each one
+ * needs is in the generated assets/assets.h.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "asset_loader.h"
+#include "lz.h"
+#include <string.h>
+
+void init_asset_loader(AssetLoader *loader)
+{
+   loader->head = 0;
+   loader->count = 0;
+   loader->reading = false;
+   memset(&(loader->stats), 0, sizeof(loader->stats));
+}
+
+static bool queue_request(AssetLoader *loader, const char *path, uint32_t *buffer, size_t capacity,
+                          AssetCallback callback, void *user, bool packed)
+{
+   if (loader->count == ASSET_QUEUE_LENGTH)
+   {
+      return false;
+   }
+
+   AssetRequest *request = &(loader->queue[(loader->head + loader->count) % ASSET_QUEUE_LENGTH]);
+
+   request->path = path;
+   request->buffer = buffer;
+   request->capacity = capacity;
+   request->callback = callback;
+   request->user = user;
+   request->size = 0;
+   request->packed = packed;
+   request->read_offset = 0;
+   loader->count++;
+
+   return true;
+}
+
+// Queues a file to be read into buffer (capacity bytes, see
+// ASSET_BUFFER_WORDS()). Returns false if the queue is full.
+bool request_asset(AssetLoader *loader, const char *path, uint32_t *buffer, size_t capacity,
+                   AssetCallback callback, void *user)
+{
+   return queue_request(loader, path, buffer, capacity, callback, user, false);
+}
+
+// Same for an LZ packed file, the callback gets the unpacked data
+bool request_packed_asset(AssetLoader *loader, const char *path, uint32_t *buffer, size_t capacity,
+                          AssetCallback callback, void *user)
+{
+   return queue_request(loader, path, buffer, capacity, callback, user, true);
+}
+
+// Unpacks a packed file from the end of the buffer to its start
+static bool unpack_request(AssetLoader *loader, AssetRequest *request)
+{
+   const uint8_t *packed = (const uint8_t *)request->buffer + request->read_offset;
+   const LzHeader *header = (const LzHeader *)packed;
+
+   if (request->size < sizeof(LzHeader) || !lz_is_packed(packed) || request->read_offset < header->margin)
+   {
+      return false;
+   }
+
+   uint32_t size = header->size;
+   uint16_t start = platform_hblank_ticks();
+
+   if (!lz_unpack(packed, request->buffer, request->capacity))
+   {
+      return false;
+   }
+
+   loader->stats.unpack_lines += (uint16_t)(platform_hblank_ticks() - start);
+   loader->stats.bytes_unpacked += size;
+   request->size = size;
+   return true;
+}
+
+static void complete_request(AssetLoader *loader, bool ok)
+{
+   AssetRequest request = loader->queue[loader->head];
+
+   loader->head = (loader->head + 1) % ASSET_QUEUE_LENGTH;
+   loader->count--;
+   loader->reading = false;
+
+   if (ok)
+   {
+      loader->stats.bytes_read += request.size;
+      if (request.packed)
+      {
+         ok = unpack_request(loader, &request);
+      }
+   }
+
+   // The callback may queue more requests
+   request.callback(ok ? request.buffer : NULL, request.size, request.user);
+}
+
+static bool start_request(AssetRequest *request)
+{
+   uint32_t sector;
+
+   if (!platform_cd_find_file(request->path, &sector, &(request->size)))
+   {
+      return false;
+   }
+
+   int sectors = (request->size + PLATFORM_CD_SECTOR_SIZE - 1) / PLATFORM_CD_SECTOR_SIZE;
+   size_t read_length = (size_t)sectors * PLATFORM_CD_SECTOR_SIZE;
+
+   if (read_length > request->capacity)
+   {
+      return false;
+   }
+
+   // Packed files go to the end of the buffer
+   request->read_offset = request->packed ? (uint32_t)((request->capacity - read_length) & ~(size_t)3) : 0;
+
+   return platform_cd_read(sector, sectors, request->buffer + request->read_offset / 4);
+}
+
+void update_asset_loader(AssetLoader *loader)
+{
+   if (loader->reading)
+   {
+      int status = platform_cd_read_status();
+
+      if (status > 0)
+      {
+         return;
+      }
+      complete_request(loader, status == 0);
+   }
+
+   // Keep the drive busy, failed requests complete right away
+   while (loader->count > 0 && !loader->reading)
+   {
+      if (start_request(&(loader->queue[loader->head])))
+      {
+         loader->reading = true;
+      }
+      else
+      {
+         complete_request(loader, false);
+      }
+   }
+}
+
+bool asset_loader_busy(const AssetLoader *loader)
+{
+   return loader->count > 0;
+}
@@ -0,0 +1,58 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "platform.h"
+
+// Requests that can wait in the queue
+#define ASSET_QUEUE_LENGTH 16
+
+// Number of uint32_t words a buffer for a file of `bytes` bytes needs. Reads
+// are done in whole sectors.
+#define ASSET_BUFFER_WORDS(bytes) \
+   ((((bytes) + PLATFORM_CD_SECTOR_SIZE - 1) / PLATFORM_CD_SECTOR_SIZE) * (PLATFORM_CD_SECTOR_SIZE / 4))
+
+// Called from update_asset_loader() once a file is in its buffer, with
+// data == NULL if it couldn't be found or read or was too big.
+typedef void (*AssetCallback)(const uint32_t *data, size_t size, void *user);
+
+typedef struct
+{
+   const char *path;
+   uint32_t *buffer;
+   size_t capacity; // Bytes
+   AssetCallback callback;
+   void *user;
+   uint32_t size;
+   bool packed;          // LZ packed file (lz.h), unpacked in place
+   uint32_t read_offset; // Where in the buffer the file is read to
+} AssetRequest;
+
+// Totals over every completed request, for benchmarking
+typedef struct
+{
+   uint32_t bytes_read;
+   uint32_t bytes_unpacked;
+   uint32_t unpack_lines; // Time spent unpacking, in hblanks
+} AssetLoaderStats;
+
+typedef struct
+{
+   AssetRequest queue[ASSET_QUEUE_LENGTH];
+   int head;
+   int count;
+   bool reading; // The request at head is being read
+   AssetLoaderStats stats;
+} AssetLoader;
+
+void init_asset_loader(AssetLoader *loader);
+bool request_asset(AssetLoader *loader, const char *path, uint32_t *buffer, size_t capacity,
+                   AssetCallback callback, void *user);
+bool request_packed_asset(AssetLoader *loader, const char *path, uint32_t *buffer, size_t capacity,
+                          AssetCallback callback, void *user);
+void update_asset_loader(AssetLoader *loader);
+bool asset_loader_busy(const AssetLoader *loader);
+
+#endif // ASSET_LOADER_H
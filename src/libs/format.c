@@ -0,0 +1,160 @@
+/**
+ * @file format.c
+ * @brief Allocation-free number formatting
+ *
+ * Small replacements for the sprintf() patterns used in the main loop. The
+ * R3000 divide takes ~36 cycles, so digits are extracted with a reciprocal
+ * multiply (a single multu, upper word) instead, and fixed point fractions
+ * with a multiply by 10 and a shift. Output goes straight into the caller's
+ * buffer; nothing is allocated and no libc formatter is pulled in.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "format.h"
+
+static const char hex_digits[16] = "0123456789ABCDEF";
+
+// value / 10 for any 32-bit value: 0xCCCCCCCD / 2^35 ~= 1/10
+static inline uint32_t div10(uint32_t value)
+{
+   return (uint32_t)(((uint64_t)value * 0xCCCCCCCDu) >> 35);
+}
+
+// Writes the digits of value right to left, ending just before `end`.
+// Returns a pointer to the first digit.
+static char *write_digits(char *end, uint32_t value)
+{
+   do
+   {
+      uint32_t quotient = div10(value);
+
+      *--end = (char)('0' + (value - quotient * 10));
+      value = quotient;
+   } while (value);
+
+   return end;
+}
+
+static int copy_digits(char *buffer, const char *digits, const char *end)
+{
+   int length = (int)(end - digits);
+
+   for (int i = 0; i < length; i++)
+   {
+      buffer[i] = digits[i];
+   }
+   buffer[length] = 0;
+
+   return length;
+}
+
+int format_uint(char *buffer, uint32_t value)
+{
+   char digits[10];
+   char *end = &digits[10];
+
+   return copy_digits(buffer, write_digits(end, value), end);
+}
+
+int format_int(char *buffer, int32_t value)
+{
+   if (value < 0)
+   {
+      buffer[0] = '-';
+      // Negating as unsigned keeps INT32_MIN correct.
+      return 1 + format_uint(&buffer[1], 0u - (uint32_t)value);
+   }
+
+   return format_uint(buffer, (uint32_t)value);
+}
+
+// Zero padded to at least `width` characters, the sign counting towards the
+// width (like "%0*d"). Widths past FORMAT_MAX_WIDTH are clamped so the result
+// still fits FORMAT_BUFFER_SIZE.
+int format_int_padded(char *buffer, int32_t value, int width)
+{
+   char digits[10];
+   char *end = &digits[10];
+   int length = 0;
+   uint32_t magnitude = (uint32_t)value;
+
+   if (width > FORMAT_MAX_WIDTH)
+   {
+      width = FORMAT_MAX_WIDTH;
+   }
+
+   if (value < 0)
+   {
+      buffer[length++] = '-';
+      magnitude = 0u - magnitude;
+   }
+
+   char *first = write_digits(end, magnitude);
+   for (int pad = width - length - (int)(end - first); pad > 0; pad--)
+   {
+      buffer[length++] = '0';
+   }
+
+   return length + copy_digits(&buffer[length], first, end);
+}
+
+// Upper case hex, always exactly `digits` characters (clamped to 1-8), no
+// prefix.
+int format_hex(char *buffer, uint32_t value, int digits)
+{
+   if (digits < 1)
+   {
+      digits = 1;
+   }
+   else if (digits > FORMAT_MAX_HEX_DIGITS)
+   {
+      digits = FORMAT_MAX_HEX_DIGITS;
+   }
+
+   for (int i = digits - 1; i >= 0; i--)
+   {
+      buffer[i] = hex_digits[value & 0xF];
+      value >>= 4;
+   }
+   buffer[digits] = 0;
+
+   return digits;
+}
+
+// Fixed point (FIXED_BITS fractional bits) to decimal with `decimals` digits
+// after the point (clamped to 0-8). The fraction is truncated, not rounded.
+int format_fixed(char *buffer, fixed_t value, int decimals)
+{
+   int length = 0;
+   uint32_t magnitude = (uint32_t)value;
+
+   if (decimals > FORMAT_MAX_DECIMALS)
+   {
+      decimals = FORMAT_MAX_DECIMALS;
+   }
+
+   if (value < 0)
+   {
+      buffer[length++] = '-';
+      magnitude = 0u - magnitude;
+   }
+
+   length += format_uint(&buffer[length], magnitude >> FIXED_BITS);
+
+   if (decimals > 0)
+   {
+      uint32_t fraction = magnitude & FIXED_MASK;
+
+      buffer[length++] = '.';
+      for (int i = 0; i < decimals; i++)
+      {
+         fraction *= 10;
+         buffer[length++] = (char)('0' + (fraction >> FIXED_BITS));
+         fraction &= FIXED_MASK;
+      }
+      buffer[length] = 0;
+   }
+
+   return length;
+}
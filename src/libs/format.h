@@ -0,0 +1,26 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdint.h>
+#include "math.h"
+
+// Buffer size large enough for any of the functions below with a 32-bit value
+// (sign + 10 digits + '.' + up to 8 decimals + terminator)
+#define FORMAT_BUFFER_SIZE 24
+
+// format_int_padded() pads to at most this many characters
+#define FORMAT_MAX_WIDTH (FORMAT_BUFFER_SIZE - 1)
+
+// Digit counts format_hex() and format_fixed() clamp to
+#define FORMAT_MAX_HEX_DIGITS 8
+#define FORMAT_MAX_DECIMALS 8
+
+// All functions write a NUL terminated string into `buffer` and return its
+// length, without the terminator.
+int format_uint(char *buffer, uint32_t value);
+int format_int(char *buffer, int32_t value);
+int format_int_padded(char *buffer, int32_t value, int width);
+int format_hex(char *buffer, uint32_t value, int digits);
+int format_fixed(char *buffer, fixed_t value, int decimals);
+
+#endif // FORMAT_H
@@ -0,0 +1,88 @@
+/**
+ * @file frame_clock.c
+ * @brief Fixed timestep game loop driven by the vblank counter
+ *
+ * Running the game logic once per drawn frame ties game speed to the frame
+ * rate: everything is 17% slower on a 50 Hz PAL console and slows down
+ * whenever a frame takes longer than a vblank. The frame clock decouples the
+ * two: the logic runs at a fixed tick rate, and each frame runs as many
+ * ticks as the vblanks elapsed since the previous one call for.
+ *
+ * Time is kept exactly, in integers: every vblank adds tick_rate to the
+ * accumulator and every tick takes refresh_rate out. At 60 ticks per second
+ * an NTSC console runs one tick per vblank and a PAL one six ticks every five
+ * vblanks.
+ *
+ * When a frame runs long, the next one runs the ticks it missed before being
+ * drawn, so it's rendering that gets skipped, never simulation. Past
+ * max_ticks the extra time is dropped instead, so a long stall (loading,
+ * debugger) doesn't turn into a burst of catch-up ticks. The render rate can
+ * be lowered (set_render_interval()) without changing the game speed.
+ *
+ * Usage, once per frame:
+ *    int ticks = frame_clock_begin(&clock);
+ *    for (int i = 0; i < ticks; i++) { read input, update the game }
+ *    draw
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "frame_clock.h"
+#include "platform.h"
+
+void init_frame_clock(FrameClock *clock, uint32_t tick_rate, int max_ticks)
+{
+   clock->tick_rate = tick_rate;
+   clock->refresh_rate = platform_is_pal() ? 50 : 60;
+   clock->render_interval = 1;
+   clock->max_ticks = max_ticks;
+
+   clock->last_vblank = platform_vblank_count();
+   clock->accumulator = 0;
+
+   clock->ticks = 0;
+   clock->frames = 0;
+   clock->skipped_frames = 0;
+   clock->dropped_ticks = 0;
+}
+
+// Draws a frame every `vblanks` vblanks at most, e.g. 2 for 30 fps on NTSC
+void set_render_interval(FrameClock *clock, uint32_t vblanks)
+{
+   clock->render_interval = vblanks ? vblanks : 1;
+}
+
+// Waits until the next frame is due and returns the number of ticks to run
+// before drawing it.
+int frame_clock_begin(FrameClock *clock)
+{
+   uint32_t now;
+
+   while ((now = platform_vblank_count()) - clock->last_vblank < clock->render_interval)
+   {
+      platform_idle();
+   }
+
+   uint32_t elapsed = now - clock->last_vblank;
+   int ticks = 0;
+
+   clock->last_vblank = now;
+   clock->skipped_frames += elapsed - clock->render_interval;
+   clock->accumulator += elapsed * clock->tick_rate;
+
+   while (clock->accumulator >= clock->refresh_rate)
+   {
+      clock->accumulator -= clock->refresh_rate;
+      ticks++;
+   }
+
+   if (ticks > clock->max_ticks)
+   {
+      clock->dropped_ticks += ticks - clock->max_ticks;
+      ticks = clock->max_ticks;
+   }
+
+   clock->ticks += ticks;
+   clock->frames++;
+   return ticks;
+}
@@ -0,0 +1,33 @@
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Simulation rate the game logic is written for, on both video standards
+#define DEFAULT_TICK_RATE 60
+
+// Most ticks caught up in one frame; time past that is dropped
+#define DEFAULT_MAX_TICKS 4
+
+typedef struct
+{
+   uint32_t tick_rate;       // Simulation ticks per second
+   uint32_t refresh_rate;    // Vblanks per second: 50 (PAL) or 60 (NTSC)
+   uint32_t render_interval; // Vblanks between drawn frames, at least 1
+   int max_ticks;
+
+   uint32_t last_vblank;
+   uint32_t accumulator; // Time not simulated yet, in 1 / (tick_rate * refresh_rate) s
+
+   uint32_t ticks;          // Ticks run so far
+   uint32_t frames;         // Frames drawn so far
+   uint32_t skipped_frames; // Vblanks that got no frame of their own
+   uint32_t dropped_ticks;  // Ticks lost to max_ticks
+} FrameClock;
+
+void init_frame_clock(FrameClock *clock, uint32_t tick_rate, int max_ticks);
+void set_render_interval(FrameClock *clock, uint32_t vblanks);
+int frame_clock_begin(FrameClock *clock);
+
+#endif // FRAME_CLOCK_H
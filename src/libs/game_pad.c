@@ -10,17 +10,38 @@
  * - Automatic pad system initialization
  * - Support for digital and analog controllers
  * - Button press/release edge detection
- * - Structured access to different button groups (D-pad, face, shoulder, system)
- * - Normalized analog stick values (-1.0 to 1.0)
+ * - Packed state: button masks, flags and stick bytes in a 20 byte GamePad,
+ *   read through the PAD_* accessor macros. The per-button bools of older
+ *   code are still available with GAME_PAD_LEGACY_FIELDS.
+ * - Normalized analog stick values (-1.0 to 1.0), or in fixed point through a
+ *   lookup table with a dead zone and response curve (AnalogResponse)
  * - Connection state monitoring
+ * - Multitaps: up to 4 pads per port, 8 in total, synced in one pass by a
+ *   PadManager (with the SIO pad driver)
+ * - Optional capture from the vsync interrupt (enable_pad_capture()), with
+ *   timestamped samples and a queue of every press/release
+ * - Recording and playback of what sync_all_pads() sees, see input_record.c
+ * - Optional late polling (enable_late_pad_poll()): the first sync of a
+ *   frame polls the pads itself instead of using what the driver read earlier
+ * - Input changes reported to the latency measurement, see input_latency.c
  * 
- * The module maintains internal buffers for up to 2 controllers and handles
- * the conversion between PSX pad format (inverted button logic) and a more
- * intuitive boolean representation.
+ * Without capture, sync_pad() reads the buffers the BIOS driver keeps updated
+ * at whatever point of the frame it runs, and edges are found by comparing
+ * two consecutive calls: a tap that starts and ends between them is lost.
+ * With capture, an interrupt callback (the driver's poll callback, or vsync
+ * with the BIOS driver) copies both ports into a double-buffered snapshot
+ * right after the driver polled them, accumulates the edges until
+ * the next sync_pad(), and appends every change to a single producer/single
+ * consumer ring that poll_pad_event() drains without masking interrupts.
+ * 
+ * The module maintains internal buffers for both ports and handles
+ * the conversion between PSX pad format (inverted button logic) and button
+ * masks where a set bit means pressed.
  * 
  * Usage:
  * 1. Initialize a gamepad with init_game_pad()
- * 2. Call sync_pad() each frame to update button states
+ * 2. Call sync_pad() each frame to update button states, or keep every slot
+ *    in a PadManager and call sync_all_pads() once instead
  * 3. Use the various query functions to check button states
  * 4. Clean up with cleanup_game_pad() when done
  * 
@@ -28,27 +49,105 @@
  * @date Current
  */
 #include "game_pad.h"
-#include <psxpad.h>
+#include "input_record.h"
+#include "input_latency.h"
+#include "platform.h"
 #include <string.h>
 
-// Internal pad buffer
-static PADTYPE pad_buffer[2][34 / 2];
+// Bytes the driver fills per port, enough for a multitap: it answers with a
+// 2 byte header followed by an 8 byte frame (the start of a PADTYPE) per slot.
+// Only the SIO driver switches taps to that mode and stores their frames this
+// way (see sio_pad.c); with the BIOS driver a tap reads as the pad in slot A.
+#define PORT_BUFFER_SIZE 34
+#define MULTITAP_HEADER_SIZE 2
+#define MULTITAP_FRAME_SIZE 8
+#define MULTITAP_TYPE 0x8
+
+// Pad types (high nibble of the id) that send stick axes: the analog
+// joystick (0x53) and the DualShock in analog mode (0x73, or 0x79 with
+// pressure)
+#define ANALOG_STICK_TYPE 0x5
+#define ANALOG_PAD_TYPE 0x7
+
+// Internal pad buffer, in halfwords to keep btn aligned
+static uint16_t pad_buffer[MAX_PAD_PORTS][PORT_BUFFER_SIZE / 2];
 static bool pad_system_initialized = false;
 
+// Both ports as seen by one vsync interrupt
+typedef struct
+{
+   uint16_t ports[MAX_PAD_PORTS][PORT_BUFFER_SIZE / 2];
+   uint32_t vblank;
+   uint16_t hblank;
+} PadSnapshot;
+
+// The interrupt fills the snapshot the game isn't reading, then flips
+static PadSnapshot snapshots[2];
+static volatile int front_snapshot = 0;
+static bool capture_enabled = false;
+static PlatformCallback chained_vsync_callback = NULL;
+
+// Polls the driver reported finished, and whether it reports them at all
+static volatile uint32_t polls_completed = 0;
+static bool driver_reports_polls = false;
+
+// With late polling, the first sync after each vblank polls the pads itself
+static bool late_poll = false;
+static uint32_t late_poll_vblank = 0;
+
+// Edges seen by the interrupt since the last sync of each slot
+static uint16_t captured_buttons[MAX_GAME_PADS];
+static volatile uint16_t latched_pressed[MAX_GAME_PADS];
+static volatile uint16_t latched_released[MAX_GAME_PADS];
+
+// Written by the interrupt at the head, read by the game at the tail
+static PadEvent event_queue[PAD_EVENT_QUEUE_LENGTH];
+static volatile uint32_t event_head = 0;
+static volatile uint32_t event_tail = 0;
+static volatile uint32_t dropped_events = 0;
+
+static void on_pads_polled(void);
+
 // Initialize the pad system if not already done
 static void ensure_pad_system_init(void)
 {
    if (!pad_system_initialized)
    {
-      InitPAD((char *)pad_buffer[0], 34, (char *)pad_buffer[1], 34);
-      StartPAD();
-      ChangeClearPAD(1);
+      platform_init_pads((uint8_t *)pad_buffer[0], (uint8_t *)pad_buffer[1], PORT_BUFFER_SIZE);
+      driver_reports_polls = platform_set_pad_callback(&on_pads_polled);
       pad_system_initialized = true;
    }
 }
 
+static bool is_multitap(const uint16_t *port_data)
+{
+   const PADTYPE *port_pad = (const PADTYPE *)port_data;
+
+   return port_pad->stat == 0 && port_pad->type == MULTITAP_TYPE;
+}
+
+// Extracts the pad in one multitap slot of a port buffer. Without a multitap
+// the pad plugged in directly is slot 0 and the others are empty.
+static void read_slot(const uint16_t *port_data, int tap, PADTYPE *out)
+{
+   if (is_multitap(port_data))
+   {
+      memset(out, 0, sizeof(*out));
+      memcpy(out, (const uint8_t *)port_data + MULTITAP_HEADER_SIZE + tap * MULTITAP_FRAME_SIZE,
+             MULTITAP_FRAME_SIZE);
+   }
+   else if (tap == 0)
+   {
+      *out = *(const PADTYPE *)port_data;
+   }
+   else
+   {
+      memset(out, 0xff, sizeof(*out));
+   }
+}
+
 // Convert PSX pad format to our button format
-static uint16_t convert_pad_buttons(PADTYPE *pad)
+static uint16_t convert_pad_buttons(const PADTYPE *pad)
 {
    if (pad->stat != 0)
    {
@@ -61,7 +160,8 @@ static uint16_t convert_pad_buttons(PADTYPE *pad)
    return buttons;
 }
 
-// Update button structures from raw button data
+#ifdef GAME_PAD_LEGACY_FIELDS
+// Update the compatibility fields from raw button data
 static void update_button_states(GamePad *pad)
 {
    uint16_t buttons = pad->buttons_raw;
@@ -93,12 +193,17 @@ static void update_button_states(GamePad *pad)
    // Analog sticks (L3/R3 states)
    pad->left_stick.pressed = pad->system.l3;
    pad->right_stick.pressed = pad->system.r3;
+
+   pad->connected = PAD_IS_CONNECTED(pad);
+   pad->analog_mode = PAD_IS_ANALOG(pad);
 }
+#endif
 
 // Update analog stick data
-static void update_analog_sticks(GamePad *pad, PADTYPE *psx_pad)
+static void update_analog_sticks(GamePad *pad, const PADTYPE *psx_pad)
 {
-   if (pad->analog_mode && psx_pad->len >= 6)
+   // len counts halfwords: buttons plus the 4 axis bytes
+   if (PAD_IS_ANALOG(pad) && psx_pad->len >= 3)
    {
       // Analog data is available
       pad->left_stick.x = psx_pad->rs_x;
@@ -116,16 +221,173 @@ static void update_analog_sticks(GamePad *pad, PADTYPE *psx_pad)
    }
 }
 
+static void queue_pad_event(const PadEvent *event)
+{
+   // The tail only moves forward, so a stale read can only make the queue look
+   // fuller than it is.
+   if (event_head - event_tail >= PAD_EVENT_QUEUE_LENGTH)
+   {
+      dropped_events++;
+      return;
+   }
+
+   event_queue[event_head & (PAD_EVENT_QUEUE_LENGTH - 1)] = *event;
+   event_head++;
+}
+
+static void capture_pads(void)
+{
+   PadSnapshot *snapshot = &snapshots[front_snapshot ^ 1];
+
+   snapshot->vblank = platform_vblank_count();
+   snapshot->hblank = platform_hblank_ticks();
+   memcpy(snapshot->ports, pad_buffer, sizeof(pad_buffer));
+
+   for (int slot = 0; slot < MAX_GAME_PADS; slot++)
+   {
+      PADTYPE psx_pad;
+
+      read_slot(snapshot->ports[PAD_SLOT_PORT(slot)], PAD_SLOT_TAP(slot), &psx_pad);
+
+      uint16_t buttons = convert_pad_buttons(&psx_pad);
+      uint16_t changed = buttons ^ captured_buttons[slot];
+
+      if (changed)
+      {
+         PadEvent event;
+
+         event.vblank = snapshot->vblank;
+         event.hblank = snapshot->hblank;
+         event.slot = (uint8_t)slot;
+         event.connected = psx_pad.stat == 0;
+         event.buttons = buttons;
+         event.pressed = changed & buttons;
+         event.released = changed & ~buttons;
+
+         latched_pressed[slot] |= event.pressed;
+         latched_released[slot] |= event.released;
+         queue_pad_event(&event);
+
+         captured_buttons[slot] = buttons;
+      }
+   }
+
+   front_snapshot ^= 1;
+}
+
+// Called by the driver from its interrupt once both ports are updated
+static void on_pads_polled(void)
+{
+   polls_completed++;
+
+   if (capture_enabled)
+   {
+      capture_pads();
+   }
+}
+
+static void pad_capture_vsync_callback(void)
+{
+   if (chained_vsync_callback)
+   {
+      chained_vsync_callback();
+   }
+
+   capture_pads();
+}
+
+void enable_pad_capture(void)
+{
+   if (capture_enabled)
+   {
+      return;
+   }
+
+   ensure_pad_system_init();
+
+   platform_enter_critical();
+   capture_enabled = true;
+   memcpy(snapshots[front_snapshot].ports, pad_buffer, sizeof(pad_buffer));
+   for (int slot = 0; slot < MAX_GAME_PADS; slot++)
+   {
+      PADTYPE psx_pad;
+
+      read_slot(pad_buffer[PAD_SLOT_PORT(slot)], PAD_SLOT_TAP(slot), &psx_pad);
+      captured_buttons[slot] = convert_pad_buttons(&psx_pad);
+   }
+
+   // Right after each poll when the driver reports them (on_pads_polled()),
+   // at vsync otherwise
+   if (!driver_reports_polls)
+   {
+      chained_vsync_callback = platform_set_vsync_callback(&pad_capture_vsync_callback);
+   }
+   platform_exit_critical();
+}
+
+bool enable_late_pad_poll(void)
+{
+   ensure_pad_system_init();
+
+   late_poll = driver_reports_polls;
+   late_poll_vblank = platform_vblank_count() - 1;
+   return late_poll;
+}
+
+// Polls the pads and waits for the driver, once per frame. A vblank passing
+// without the poll finishing (polling disabled) ends the wait.
+static void poll_pads_now(void)
+{
+   uint32_t vblank = platform_vblank_count();
+
+   if (!late_poll || vblank == late_poll_vblank)
+   {
+      return;
+   }
+
+   uint32_t polls = polls_completed;
+
+   late_poll_vblank = vblank;
+   platform_poll_pads();
+   while (polls_completed == polls && platform_vblank_count() - vblank < 2)
+   {
+      platform_idle();
+   }
+}
+
+bool poll_pad_event(PadEvent *event)
+{
+   uint32_t tail = event_tail;
+
+   if (tail == event_head)
+   {
+      return false;
+   }
+
+   *event = event_queue[tail & (PAD_EVENT_QUEUE_LENGTH - 1)];
+   event_tail = tail + 1;
+   return true;
+}
+
+uint32_t get_dropped_pad_events(void)
+{
+   return dropped_events;
+}
+
 GamePad init_game_pad(uint8_t port)
+{
+   return init_tap_pad(port, 0);
+}
+
+GamePad init_tap_pad(uint8_t port, uint8_t tap)
 {
    GamePad pad = {0};
 
    ensure_pad_system_init();
 
    pad.port = port;
-   pad.connected = false;
-   pad.analog_mode = false;
-   pad.initialized = true;
+   pad.tap = tap;
+   pad.flags = PAD_FLAG_INITIALIZED;
 
    // Initialize analog sticks to center position
    pad.left_stick.x = 128;
@@ -136,73 +398,236 @@ GamePad init_game_pad(uint8_t port)
    return pad;
 }
 
-void sync_pad(GamePad *pad)
+// Takes the port buffers to decode (the latest snapshot with capture enabled),
+// and with capture the edges of the slots in the mask, all at once so that
+// they match.
+static void take_pad_state(uint16_t ports[MAX_PAD_PORTS][PORT_BUFFER_SIZE / 2], uint8_t slot_mask,
+                           uint16_t *pressed, uint16_t *released, uint32_t *vblank, uint16_t *hblank)
 {
-   if (!pad->initialized)
+   if (!capture_enabled)
    {
+      memcpy(ports, pad_buffer, sizeof(pad_buffer));
+      *vblank = platform_vblank_count();
+      *hblank = platform_hblank_ticks();
       return;
    }
 
-   PADTYPE *psx_pad = (PADTYPE *)&pad_buffer[pad->port];
+   platform_enter_critical();
+   const PadSnapshot *snapshot = &snapshots[front_snapshot];
+
+   memcpy(ports, snapshot->ports, sizeof(snapshot->ports));
+   *vblank = snapshot->vblank;
+   *hblank = snapshot->hblank;
+   for (int slot = 0; slot < MAX_GAME_PADS; slot++)
+   {
+      if (slot_mask & (1 << slot))
+      {
+         pressed[slot] = latched_pressed[slot];
+         released[slot] = latched_released[slot];
+         latched_pressed[slot] = 0;
+         latched_released[slot] = 0;
+      }
+   }
+   platform_exit_critical();
+}
+
+// With has_edges, pressed and released come from the capture or a recording
+// instead of the difference with the last state.
+static void update_pad_state(GamePad *pad, const PADTYPE *psx_pad, bool has_edges, uint16_t pressed,
+                             uint16_t released)
+{
+   uint16_t previous_buttons = pad->buttons_raw;
+
+   pad->flags &= ~(PAD_FLAG_CONNECTED | PAD_FLAG_ANALOG);
 
    // Check if pad is connected
    if (psx_pad->stat == 0)
    {
-      pad->connected = true;
+      pad->flags |= PAD_FLAG_CONNECTED;
       pad->pad_type = psx_pad->type;
 
       // Check if analog mode is available
-      pad->analog_mode = (psx_pad->type == 0x73) || (psx_pad->type == 0x79);
-
-      // Store previous button state for edge detection
-      pad->previous_buttons = pad->buttons_raw;
+      if (psx_pad->type == ANALOG_PAD_TYPE || psx_pad->type == ANALOG_STICK_TYPE)
+      {
+         pad->flags |= PAD_FLAG_ANALOG;
+      }
 
       // Update button state
       pad->buttons_raw = convert_pad_buttons(psx_pad);
 
-      // Calculate pressed/released buttons
-      pad->buttons_pressed = pad->buttons_raw & (~pad->previous_buttons);
-      pad->buttons_released = (~pad->buttons_raw) & pad->previous_buttons;
-
-      // Update all button structures
-      update_button_states(pad);
-
-      // Update analog sticks if available
-      update_analog_sticks(pad, psx_pad);
+      // Calculate pressed/released buttons. The capture also reports taps
+      // that came and went between two calls.
+      if (has_edges)
+      {
+         pad->buttons_pressed = pressed;
+         pad->buttons_released = released;
+      }
+      else
+      {
+         pad->buttons_pressed = pad->buttons_raw & (~previous_buttons);
+         pad->buttons_released = (~pad->buttons_raw) & previous_buttons;
+      }
    }
    else
    {
-      pad->connected = false;
-      pad->analog_mode = false;
-
       // Clear all button states
-      memset(&pad->dpad, 0, sizeof(pad->dpad));
-      memset(&pad->face, 0, sizeof(pad->face));
-      memset(&pad->shoulder, 0, sizeof(pad->shoulder));
-      memset(&pad->system, 0, sizeof(pad->system));
-
       pad->buttons_raw = 0;
       pad->buttons_pressed = 0;
       pad->buttons_released = 0;
+   }
 
-      // Reset analog sticks to center
-      pad->left_stick.x = 128;
-      pad->left_stick.y = 128;
-      pad->right_stick.x = 128;
-      pad->right_stick.y = 128;
-      pad->left_stick.pressed = false;
-      pad->right_stick.pressed = false;
+   // Update analog sticks if available, centered otherwise
+   update_analog_sticks(pad, psx_pad);
+
+#ifdef GAME_PAD_LEGACY_FIELDS
+   update_button_states(pad);
+#endif
+}
+
+void sync_pad(GamePad *pad)
+{
+   if (!(pad->flags & PAD_FLAG_INITIALIZED))
+   {
+      return;
+   }
+
+   int slot = PAD_SLOT(pad->port, pad->tap);
+   uint16_t ports[MAX_PAD_PORTS][PORT_BUFFER_SIZE / 2];
+   uint16_t pressed[MAX_GAME_PADS] = {0};
+   uint16_t released[MAX_GAME_PADS] = {0};
+   PADTYPE psx_pad;
+
+   poll_pads_now();
+   take_pad_state(ports, 1 << slot, pressed, released, &pad->sample_vblank, &pad->sample_hblank);
+   read_slot(ports[pad->port], pad->tap, &psx_pad);
+   update_pad_state(pad, &psx_pad, capture_enabled, pressed[slot], released[slot]);
+
+   if (pad->buttons_pressed | pad->buttons_released)
+   {
+      input_latency_sample(pad->sample_vblank, pad->sample_hblank);
    }
 }
 
-void cleanup_game_pad(GamePad *pad)
+void init_pad_manager(PadManager *manager)
 {
-   if (pad->initialized)
+   memset(manager, 0, sizeof(*manager));
+
+   for (int slot = 0; slot < MAX_GAME_PADS; slot++)
    {
-      pad->initialized = false;
+      manager->pads[slot] = init_tap_pad(PAD_SLOT_PORT(slot), PAD_SLOT_TAP(slot));
    }
 }
 
+// Conversions between the driver's view of a slot and a recorded sample
+static void sample_from_pad(InputSample *sample, const PADTYPE *psx_pad, const GamePad *pad)
+{
+   memcpy(sample, psx_pad, MULTITAP_FRAME_SIZE);
+   sample->pressed = pad->buttons_pressed;
+   sample->released = pad->buttons_released;
+}
+
+static void pad_from_sample(PADTYPE *psx_pad, const InputSample *sample)
+{
+   memset(psx_pad, 0, sizeof(*psx_pad));
+   memcpy(psx_pad, sample, MULTITAP_FRAME_SIZE);
+}
+
+void sync_all_pads(PadManager *manager)
+{
+   uint16_t ports[MAX_PAD_PORTS][PORT_BUFFER_SIZE / 2];
+   uint16_t pressed[MAX_GAME_PADS] = {0};
+   uint16_t released[MAX_GAME_PADS] = {0};
+   uint32_t vblank = 0;
+   uint16_t hblank = 0;
+   InputSample samples[MAX_GAME_PADS];
+
+   // One copy of both ports (and one critical section with capture) for all
+   // the slots. The capture's edges are taken even during playback so that
+   // they don't pile up.
+   poll_pads_now();
+   take_pad_state(ports, 0xff, pressed, released, &vblank, &hblank);
+
+   bool playing = input_playback_next(samples);
+   bool recording = input_record_is_active();
+
+   // Slots without a GamePad are recorded as empty
+   for (int slot = 0; recording && !playing && slot < MAX_GAME_PADS; slot++)
+   {
+      memset(&samples[slot], 0xff, sizeof(InputSample));
+      samples[slot].pressed = 0;
+      samples[slot].released = 0;
+   }
+
+   for (int port = 0; port < MAX_PAD_PORTS; port++)
+   {
+      manager->multitap[port] = is_multitap(ports[port]);
+   }
+
+   manager->connected = 0;
+   for (int slot = 0; slot < MAX_GAME_PADS; slot++)
+   {
+      GamePad *pad = &manager->pads[slot];
+      PADTYPE psx_pad;
+
+      if (!(pad->flags & PAD_FLAG_INITIALIZED))
+      {
+         continue;
+      }
+
+      pad->sample_vblank = vblank;
+      pad->sample_hblank = hblank;
+
+      if (playing)
+      {
+         pad_from_sample(&psx_pad, &samples[slot]);
+         update_pad_state(pad, &psx_pad, true, samples[slot].pressed, samples[slot].released);
+      }
+      else
+      {
+         read_slot(ports[pad->port], pad->tap, &psx_pad);
+         update_pad_state(pad, &psx_pad, capture_enabled, pressed[slot], released[slot]);
+      }
+
+      if (recording)
+      {
+         sample_from_pad(&samples[slot], &psx_pad, pad);
+      }
+
+      if (pad->buttons_pressed | pad->buttons_released)
+      {
+         input_latency_sample(vblank, hblank);
+      }
+
+      if (PAD_IS_CONNECTED(pad))
+      {
+         manager->connected++;
+      }
+   }
+
+   if (recording)
+   {
+      input_record_append(samples);
+   }
+}
+
+GamePad *get_game_pad(PadManager *manager, int slot)
+{
+   return &manager->pads[slot];
+}
+
+void cleanup_pad_manager(PadManager *manager)
+{
+   for (int slot = 0; slot < MAX_GAME_PADS; slot++)
+   {
+      cleanup_game_pad(&manager->pads[slot]);
+   }
+}
+
+void cleanup_game_pad(GamePad *pad)
+{
+   pad->flags &= ~PAD_FLAG_INITIALIZED;
+}
+
 bool is_button_pressed(const GamePad *pad, uint16_t button)
 {
    return (pad->buttons_raw & button) != 0;
@@ -220,7 +645,7 @@ bool is_button_just_released(const GamePad *pad, uint16_t button)
 
 bool is_analog_available(const GamePad *pad)
 {
-   return pad->connected && pad->analog_mode;
+   return PAD_IS_CONNECTED(pad) && PAD_IS_ANALOG(pad);
 }
 
 float get_analog_x_normalized(const GamePad *pad, bool left_stick)
@@ -249,3 +674,91 @@ float get_analog_y_normalized(const GamePad *pad, bool left_stick)
    // Note: Y axis might need to be inverted depending on preference
    return (raw_value - 128.0f) / 128.0f;
 }
+
+void init_analog_response(AnalogResponse *response, int dead_zone, int outer_zone, fixed_t curve, bool radial)
+{
+   response->dead_zone = (uint8_t)dead_zone;
+   response->radial = radial;
+
+   // The radial check happens on the whole stick, the table only shapes what
+   // is left.
+   int table_dead_zone = radial ? 0 : dead_zone;
+   int range = outer_zone - table_dead_zone;
+
+   if (range < 1)
+   {
+      range = 1;
+   }
+
+   for (int raw = 0; raw < 256; raw++)
+   {
+      int offset = raw - 128;
+      int magnitude = offset < 0 ? -offset : offset;
+      fixed_t value = 0;
+
+      if (magnitude > table_dead_zone)
+      {
+         fixed_t t = ((magnitude - table_dead_zone) << FIXED_BITS) / range;
+
+         if (t > FIXED_ONE)
+         {
+            t = FIXED_ONE;
+         }
+
+         fixed_t cubic = fixed_mul(fixed_mul(t, t), t);
+         value = t + fixed_mul(curve, cubic - t);
+      }
+
+      response->table[raw] = offset < 0 ? -value : value;
+   }
+}
+
+static const AnalogStick *select_stick(const GamePad *pad, bool left_stick)
+{
+   return left_stick ? &pad->left_stick : &pad->right_stick;
+}
+
+static bool in_radial_dead_zone(const AnalogStick *stick, const AnalogResponse *response)
+{
+   int dx = stick->x - 128;
+   int dy = stick->y - 128;
+
+   return dx * dx + dy * dy <= response->dead_zone * response->dead_zone;
+}
+
+static fixed_t lookup_axis(const GamePad *pad, bool left_stick, const AnalogResponse *response, bool y_axis)
+{
+   if (!is_analog_available(pad))
+   {
+      return 0;
+   }
+
+   const AnalogStick *stick = select_stick(pad, left_stick);
+
+   if (response->radial && in_radial_dead_zone(stick, response))
+   {
+      return 0;
+   }
+
+   return response->table[y_axis ? stick->y : stick->x];
+}
+
+fixed_t get_analog_x_fixed(const GamePad *pad, bool left_stick, const AnalogResponse *response)
+{
+   return lookup_axis(pad, left_stick, response, false);
+}
+
+fixed_t get_analog_y_fixed(const GamePad *pad, bool left_stick, const AnalogResponse *response)
+{
+   return lookup_axis(pad, left_stick, response, true);
+}
+
+int get_analog_x_delta(const GamePad *pad, bool left_stick, const AnalogResponse *response, int max_delta)
+{
+   return get_analog_x_fixed(pad, left_stick, response) * max_delta / FIXED_ONE;
+}
+
+int get_analog_y_delta(const GamePad *pad, bool left_stick, const AnalogResponse *response, int max_delta)
+{
+   return get_analog_y_fixed(pad, left_stick, response) * max_delta / FIXED_ONE;
+}
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "math.h"
 
 // Pad button definitions
 #define PAD_BUTTON_SELECT   0x0001
@@ -22,7 +23,34 @@
 #define PAD_BUTTON_X        0x4000
 #define PAD_BUTTON_SQUARE   0x8000
 
-// D-Pad structure for easy access
+// Pads are addressed by slot: the port, and the multitap connector on that
+// port. A pad plugged in without a multitap is on connector 0.
+#define MAX_PAD_PORTS 2
+#define MAX_TAP_SLOTS 4
+#define MAX_GAME_PADS (MAX_PAD_PORTS * MAX_TAP_SLOTS)
+
+#define PAD_SLOT(port, tap) ((port) * MAX_TAP_SLOTS + (tap))
+#define PAD_SLOT_PORT(slot) ((slot) / MAX_TAP_SLOTS)
+#define PAD_SLOT_TAP(slot)  ((slot) % MAX_TAP_SLOTS)
+
+// Pad state flags
+#define PAD_FLAG_INITIALIZED 0x01
+#define PAD_FLAG_CONNECTED   0x02
+#define PAD_FLAG_ANALOG      0x04
+
+// Analog stick structure
+typedef struct {
+    uint8_t x;
+    uint8_t y;
+#ifdef GAME_PAD_LEGACY_FIELDS
+    bool pressed; // L3/R3 button
+#endif
+} AnalogStick;
+
+#ifdef GAME_PAD_LEGACY_FIELDS
+// Compatibility shim: code written against the per-button bools can define
+// GAME_PAD_LEGACY_FIELDS (for the whole build) to have sync_pad() keep
+// filling them, at the cost of the stores and the larger struct.
 typedef struct {
     bool up;
     bool down;
@@ -30,7 +58,6 @@ typedef struct {
     bool right;
 } DPad;
 
-// Face buttons structure
 typedef struct {
     bool triangle;
     bool circle;
@@ -38,7 +65,6 @@ typedef struct {
     bool square;
 } FaceButtons;
 
-// Shoulder buttons structure
 typedef struct {
     bool l1;
     bool l2;
@@ -46,53 +72,105 @@ typedef struct {
     bool r2;
 } ShoulderButtons;
 
-// System buttons structure
 typedef struct {
     bool select;
     bool start;
     bool l3;
     bool r3;
 } SystemButtons;
+#endif
 
-// Analog stick structure
+// Main GamePad structure: button states are PAD_BUTTON_* masks, read them
+// with the accessors below
 typedef struct {
-    uint8_t x;
-    uint8_t y;
-    bool pressed; // L3/R3 button
-} AnalogStick;
+    uint16_t buttons_raw;       // Held
+    uint16_t buttons_pressed;   // Newly pressed this frame
+    uint16_t buttons_released;  // Released this frame
+    uint16_t sample_hblank;
+
+    // When the state was sampled (vblank count and hblank ticks): the poll
+    // with pad capture enabled, the sync otherwise
+    uint32_t sample_vblank;
+
+    // Analog sticks, centered at 128 when not available
+    AnalogStick left_stick;
+    AnalogStick right_stick;
 
-// Main GamePad structure
-typedef struct {
     uint8_t port;
+    uint8_t tap;        // Multitap connector, 0 without one
+    uint8_t flags;      // PAD_FLAG_*
+    uint8_t pad_type;
+
+#ifdef GAME_PAD_LEGACY_FIELDS
     bool connected;
     bool analog_mode;
-    
-    // Button states
     DPad dpad;
     FaceButtons face;
     ShoulderButtons shoulder;
     SystemButtons system;
-    
-    // Analog sticks (if available)
-    AnalogStick left_stick;
-    AnalogStick right_stick;
-    
-    // Raw button data for advanced usage
-    uint16_t buttons_raw;
-    uint16_t buttons_pressed;   // Newly pressed this frame
-    uint16_t buttons_released;  // Released this frame
-    
-    // Internal state
-    uint16_t previous_buttons;
-    uint8_t pad_type;
-    bool initialized;
+#endif
 } GamePad;
 
+// Accessors, any of the buttons in the mask
+#define PAD_IS_CONNECTED(pad)          (((pad)->flags & PAD_FLAG_CONNECTED) != 0)
+#define PAD_IS_ANALOG(pad)             (((pad)->flags & PAD_FLAG_ANALOG) != 0)
+#define PAD_HELD(pad, buttons)         (((pad)->buttons_raw & (buttons)) != 0)
+#define PAD_JUST_PRESSED(pad, buttons)  (((pad)->buttons_pressed & (buttons)) != 0)
+#define PAD_JUST_RELEASED(pad, buttons) (((pad)->buttons_released & (buttons)) != 0)
+
+// Every button of the combo held, at least one of them pressed this sync
+#define PAD_COMBO_PRESSED(pad, combo) \
+    (((pad)->buttons_raw & (combo)) == (combo) && ((pad)->buttons_pressed & (combo)) != 0)
+
+// A change of the buttons of one slot, recorded by the pad capture
+typedef struct {
+    uint32_t vblank;    // Vblank count when the change was seen
+    uint16_t hblank;    // Hblank ticks at that time
+    uint8_t slot;       // See PAD_SLOT()
+    bool connected;
+    uint16_t buttons;   // State after the change
+    uint16_t pressed;   // Buttons that went down
+    uint16_t released;  // Buttons that went up
+} PadEvent;
+
+// Must be a power of two
+#define PAD_EVENT_QUEUE_LENGTH 64
+
+// Maps raw stick bytes to -FIXED_ONE..FIXED_ONE through a table built once,
+// with the dead zone and the response curve baked in. Values are in raw units
+// from the center: inside dead_zone reads 0, past outer_zone reads full scale.
+// curve blends from a linear (0) to a cubic (FIXED_ONE) response. With radial
+// set, the dead zone is a circle on the whole stick instead of a band on each
+// axis, for diagonals that don't snap to the axes.
+typedef struct {
+    fixed_t table[256];
+    uint8_t dead_zone;
+    bool radial;
+} AnalogResponse;
+
+#define DEFAULT_ANALOG_DEAD_ZONE 20
+#define DEFAULT_ANALOG_OUTER_ZONE 120
+#define DEFAULT_ANALOG_CURVE (FIXED_ONE / 2)
+
+// Every slot, synced at once: one read of both ports however many pads are
+// in use
+typedef struct {
+    GamePad pads[MAX_GAME_PADS];
+    bool multitap[MAX_PAD_PORTS];
+    uint8_t connected;  // Pads connected as of the last sync
+} PadManager;
 
 GamePad init_game_pad(uint8_t port);
+GamePad init_tap_pad(uint8_t port, uint8_t tap);
+// Not recorded or played back by input_record.h, see sync_all_pads()
 void sync_pad(GamePad* pad);
 void cleanup_game_pad(GamePad* pad);
 
+void init_pad_manager(PadManager* manager);
+void sync_all_pads(PadManager* manager);
+GamePad* get_game_pad(PadManager* manager, int slot);
+void cleanup_pad_manager(PadManager* manager);
+
 bool is_button_pressed(const GamePad* pad, uint16_t button);
 bool is_button_just_pressed(const GamePad* pad, uint16_t button);
 bool is_button_just_released(const GamePad* pad, uint16_t button);
@@ -101,4 +179,31 @@ bool is_analog_available(const GamePad* pad);
 float get_analog_x_normalized(const GamePad* pad, bool left_stick);
 float get_analog_y_normalized(const GamePad* pad, bool left_stick);
 
+// Fixed-point versions, free of soft-float: prefer these on the PS1
+void init_analog_response(AnalogResponse* response, int dead_zone, int outer_zone, fixed_t curve, bool radial);
+fixed_t get_analog_x_fixed(const GamePad* pad, bool left_stick, const AnalogResponse* response);
+fixed_t get_analog_y_fixed(const GamePad* pad, bool left_stick, const AnalogResponse* response);
+
+// The stick scaled to -max_delta..max_delta, rounded towards 0
+int get_analog_x_delta(const GamePad* pad, bool left_stick, const AnalogResponse* response, int max_delta);
+int get_analog_y_delta(const GamePad* pad, bool left_stick, const AnalogResponse* response, int max_delta);
+
+// Samples both ports from an interrupt instead of whenever sync_pad() runs:
+// the pad driver's poll callback when it has one (platform_set_pad_callback()),
+// vsync otherwise. Chains on the current vsync callback, so it must be enabled
+// after anything that replaces it (enable_render_pipeline()).
+void enable_pad_capture(void);
+
+// Samples the pads as late as possible: the first sync after each vblank has
+// the driver poll both ports and waits for it (under a millisecond with the
+// SIO driver), so the game runs on input that is only that old. Needs a
+// driver that reports its polls and should be used with PAD_POLL_ON_DEMAND,
+// returns false (and changes nothing) with the BIOS driver.
+bool enable_late_pad_poll(void);
+
+// Events queued by the capture since the last call, oldest first. Returns
+// false when there are none left.
+bool poll_pad_event(PadEvent* event);
+uint32_t get_dropped_pad_events(void);
+
 #endif // GAME_PAD_H
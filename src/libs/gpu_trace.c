@@ -0,0 +1,108 @@
+/**
+ * @file gpu_trace.c
+ * @brief GPU command stream recorder
+ *
+ * Serializes the OT and packets of selected frames (see gpu_trace.h for the
+ * format) and hands them to platform_trace_write(): over the serial port on
+ * the PS1, to HOST_TRACE_FILE on the host. tools/gpu_trace replays, compares
+ * and summarizes the captures.
+ *
+ * The chain is walked twice, once to size the frame and once to write it, so
+ * no extra memory is needed. Writing blocks until the data is sent, which at
+ * 115200 baud takes tens of ms per frame: frame timings are meaningless while
+ * a capture runs, packet contents are not.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "gpu_trace.h"
+
+static int frames_to_skip = 0;
+static int frames_to_capture = 0;
+
+void gpu_trace_request(int skip, int count)
+{
+   frames_to_skip = skip;
+   frames_to_capture = count;
+}
+
+void gpu_trace_handle_input(const GamePad *pad)
+{
+   if (PAD_COMBO_PRESSED(pad, GPU_TRACE_COMBO) && !frames_to_capture)
+   {
+      gpu_trace_request(0, GPU_TRACE_COMBO_FRAMES);
+   }
+}
+
+// Walks the chain from the last OT entry like DrawOTag() does. Returns the
+// number of trace words for the packets and writes them if write is set.
+static uint32_t walk_chain(const uint32_t *ot, int ot_length, bool write)
+{
+   const uint32_t *packet = &ot[ot_length - 1];
+   uint32_t words = 0;
+   int slot = ot_length - 1;
+
+   for (;;)
+   {
+      int length = getlen(packet);
+
+      // OT entries are empty packets, they tell which slot follows
+      if (packet >= ot && packet < &ot[ot_length])
+      {
+         slot = (int)(packet - ot);
+      }
+
+      if (length)
+      {
+         if (write)
+         {
+            uint32_t info = GPU_TRACE_PACKET_INFO(slot, length);
+
+            platform_trace_write(&info, 4);
+            platform_trace_write(&packet[1], length * 4);
+         }
+         words += 1 + length;
+      }
+
+      if (isendprim(packet))
+      {
+         break;
+      }
+      packet = (const uint32_t *)nextPrim(packet);
+   }
+
+   return words;
+}
+
+void gpu_trace_frame(const uint32_t *ot, int ot_length, const DRAWENV *env)
+{
+   if (!frames_to_capture)
+   {
+      return;
+   }
+   if (frames_to_skip)
+   {
+      frames_to_skip--;
+      return;
+   }
+
+   GpuTraceHeader header;
+
+   header.magic = GPU_TRACE_MAGIC;
+   header.frame = platform_vblank_count();
+   header.ot_length = ot_length;
+   header.word_count = walk_chain(ot, ot_length, false);
+   header.clip[0] = env->clip.x;
+   header.clip[1] = env->clip.y;
+   header.clip[2] = env->clip.w;
+   header.clip[3] = env->clip.h;
+   header.ofs[0] = env->ofs[0];
+   header.ofs[1] = env->ofs[1];
+   header.mode = env->tpage | (env->dtd << 16) | (env->dfe << 17) | (env->isbg << 18);
+   header.background = env->r0 | (env->g0 << 8) | ((uint32_t)env->b0 << 16);
+
+   platform_trace_write(&header, sizeof(header));
+   walk_chain(ot, ot_length, true);
+
+   frames_to_capture--;
+}
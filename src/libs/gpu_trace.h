@@ -0,0 +1,47 @@
+#ifndef GPU_TRACE_H
+#define GPU_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "platform.h"
+#include "game_pad.h"
+
+// Trace format, shared with tools/gpu_trace. A trace is a sequence of frames,
+// all fields are little endian 32-bit words:
+//
+//   header   GPU_TRACE_HEADER_WORDS words, see GpuTraceHeader
+//   packets  word_count words: for each non-empty packet in chain order, a
+//            GPU_TRACE_PACKET_INFO(slot, length) word followed by the
+//            length words of the packet (without its tag)
+#define GPU_TRACE_MAGIC 0x31525447 // "GTR1"
+#define GPU_TRACE_PACKET_INFO(slot, length) (((uint32_t)(slot) << 8) | (length))
+#define GPU_TRACE_PACKET_SLOT(info) ((info) >> 8)
+#define GPU_TRACE_PACKET_LENGTH(info) ((info) & 0xff)
+
+typedef struct
+{
+   uint32_t magic;
+   uint32_t frame;      // platform_vblank_count() when captured
+   uint32_t ot_length;
+   uint32_t word_count; // Packet words following the header
+   int16_t clip[4];     // DRAWENV the OT was drawn with
+   int16_t ofs[2];
+   uint32_t mode;       // tpage | dtd << 16 | dfe << 17 | isbg << 18
+   uint32_t background; // r | g << 8 | b << 16
+} GpuTraceHeader;
+
+#define GPU_TRACE_HEADER_WORDS (sizeof(GpuTraceHeader) / 4)
+
+// Holding both buttons captures GPU_TRACE_COMBO_FRAMES frames
+#define GPU_TRACE_COMBO (PAD_BUTTON_SELECT | PAD_BUTTON_L1)
+#define GPU_TRACE_COMBO_FRAMES 8
+
+// Capture count frames, starting skip frames from now
+void gpu_trace_request(int skip, int count);
+void gpu_trace_handle_input(const GamePad *pad);
+
+// Called by flip_buffers() with the finished OT, before it is drawn
+void gpu_trace_frame(const uint32_t *ot, int ot_length, const DRAWENV *env);
+
+#endif // GPU_TRACE_H
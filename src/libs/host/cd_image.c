@@ -0,0 +1,306 @@
+/**
+ * @file cd_image.c
+ * @brief CD-ROM emulation for the host build
+ *
+ * There is no disc image on the host, so the file list comes from iso.xml
+ * directly: every <file> whose source is under ${PROJECT_SOURCE_DIR} is
+ * served from the source tree, at the same ISO9660 path. Files built by CMake
+ * (the executable) are skipped. Set HOST_ISO_XML to use another iso.xml than
+ * src/iso.xml.
+ *
+ * Reads take time like on a 2x drive: a seek, then 5 sectors per vblank, so
+ * code that forgets to wait for a read fails on the host too.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "../platform.h"
+#include "cd_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define DEFAULT_ISO_XML "src/iso.xml"
+#define SOURCE_DIR_VARIABLE "${PROJECT_SOURCE_DIR}"
+
+#define MAX_FILES 64
+#define MAX_DEPTH 8
+
+// First sector used for files, after the system area and the descriptors
+#define FIRST_FILE_SECTOR 24
+
+// 2x speed: 300 sectors per second
+#define SEEK_FRAMES 6
+#define SECTORS_PER_FRAME 5
+
+typedef struct
+{
+   char path[128]; // ISO9660 path without the leading backslash and version
+   char source[512];
+   uint32_t sector;
+   uint32_t size;
+} CdFile;
+
+static CdFile files[MAX_FILES];
+static int file_count = 0;
+
+static struct
+{
+   bool active;
+   bool failed;
+   const CdFile *file;
+   uint32_t offset;
+   int count;
+   uint32_t *buffer;
+   int delay;
+   int remaining;
+} read_state;
+
+// Copies the value of attribute `name` of the tag starting at tag
+static bool get_attribute(const char *tag, const char *name, char *value, size_t size)
+{
+   const char *end = strchr(tag, '>');
+
+   for (const char *p = strstr(tag, name); p && (!end || p < end); p = strstr(p + 1, name))
+   {
+      const char *q = p + strlen(name);
+
+      if (p[-1] != ' ' && p[-1] != '\t' && p[-1] != '\n')
+      {
+         continue;
+      }
+      while (*q == ' ' || *q == '\t')
+      {
+         q++;
+      }
+      if (*q++ != '=')
+      {
+         continue;
+      }
+      while (*q == ' ' || *q == '\t')
+      {
+         q++;
+      }
+      if (*q++ != '"')
+      {
+         continue;
+      }
+
+      const char *close = strchr(q, '"');
+      size_t length = close ? (size_t)(close - q) : 0;
+
+      if (!close || length >= size)
+      {
+         return false;
+      }
+      memcpy(value, q, length);
+      value[length] = '\0';
+      return true;
+   }
+
+   return false;
+}
+
+static void add_file(const char *directories, const char *name, const char *source, const char *base_dir)
+{
+   CdFile *file = &files[file_count];
+   FILE *handle;
+
+   if (file_count == MAX_FILES || strncmp(source, SOURCE_DIR_VARIABLE, strlen(SOURCE_DIR_VARIABLE)))
+   {
+      return;
+   }
+
+   snprintf(file->path, sizeof(file->path), "%s%s", directories, name);
+   snprintf(file->source, sizeof(file->source), "%s%s", base_dir, source + strlen(SOURCE_DIR_VARIABLE));
+
+   handle = fopen(file->source, "rb");
+   if (!handle)
+   {
+      fprintf(stderr, "host: %s: can't open %s\n", file->path, file->source);
+      return;
+   }
+   fseek(handle, 0, SEEK_END);
+   file->size = (uint32_t)ftell(handle);
+   fclose(handle);
+
+   file->sector = FIRST_FILE_SECTOR;
+   if (file_count > 0)
+   {
+      const CdFile *previous = &files[file_count - 1];
+      file->sector = previous->sector + (previous->size + PLATFORM_CD_SECTOR_SIZE - 1) / PLATFORM_CD_SECTOR_SIZE;
+   }
+   file_count++;
+}
+
+void platform_init_cd(void)
+{
+   const char *xml_path = getenv("HOST_ISO_XML");
+   char base_dir[256] = ".";
+   char directories[MAX_DEPTH][128] = {""};
+   int depth = 0;
+
+   if (!xml_path)
+   {
+      xml_path = DEFAULT_ISO_XML;
+   }
+
+   const char *slash = strrchr(xml_path, '/');
+   if (slash)
+   {
+      snprintf(base_dir, sizeof(base_dir), "%.*s", (int)(slash - xml_path), xml_path);
+   }
+
+   FILE *handle = fopen(xml_path, "rb");
+   if (!handle)
+   {
+      fprintf(stderr, "host: can't open %s, the CD is empty\n", xml_path);
+      return;
+   }
+
+   fseek(handle, 0, SEEK_END);
+   long size = ftell(handle);
+   fseek(handle, 0, SEEK_SET);
+
+   char *xml = malloc(size + 1);
+   xml[fread(xml, 1, size, handle)] = '\0';
+   fclose(handle);
+
+   file_count = 0;
+   for (const char *p = strchr(xml, '<'); p; p = strchr(p + 1, '<'))
+   {
+      char name[64], source[256];
+
+      if (!strncmp(p, "<!--", 4))
+      {
+         p = strstr(p, "-->");
+         if (!p)
+         {
+            break;
+         }
+      }
+      else if (!strncmp(p, "<dir ", 5) && depth + 1 < MAX_DEPTH && get_attribute(p, "name", name, sizeof(name)))
+      {
+         depth++;
+         snprintf(directories[depth], sizeof(directories[depth]), "%s%s\\", directories[depth - 1], name);
+      }
+      else if (!strncmp(p, "</dir>", 6) && depth > 0)
+      {
+         depth--;
+      }
+      else if (!strncmp(p, "<file ", 6) && get_attribute(p, "name", name, sizeof(name)) &&
+               get_attribute(p, "source", source, sizeof(source)))
+      {
+         add_file(directories[depth], name, source, base_dir);
+      }
+   }
+
+   free(xml);
+}
+
+bool platform_cd_find_file(const char *path, uint32_t *sector, uint32_t *size)
+{
+   size_t length;
+
+   if (*path == '\\')
+   {
+      path++;
+   }
+
+   const char *version = strchr(path, ';');
+   length = version ? (size_t)(version - path) : strlen(path);
+
+   for (int i = 0; i < file_count; i++)
+   {
+      if (strlen(files[i].path) == length && !strncasecmp(files[i].path, path, length))
+      {
+         *sector = files[i].sector;
+         *size = files[i].size;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+bool platform_cd_read(uint32_t sector, int count, uint32_t *buffer)
+{
+   const CdFile *file = NULL;
+
+   for (int i = 0; i < file_count; i++)
+   {
+      uint32_t sectors = (files[i].size + PLATFORM_CD_SECTOR_SIZE - 1) / PLATFORM_CD_SECTOR_SIZE;
+
+      if (sector >= files[i].sector && sector < files[i].sector + sectors)
+      {
+         file = &files[i];
+      }
+   }
+
+   if (read_state.active || !file)
+   {
+      return false;
+   }
+
+   read_state.active = true;
+   read_state.failed = false;
+   read_state.file = file;
+   read_state.offset = (sector - file->sector) * PLATFORM_CD_SECTOR_SIZE;
+   read_state.count = count;
+   read_state.buffer = buffer;
+   read_state.delay = SEEK_FRAMES;
+   read_state.remaining = count;
+   return true;
+}
+
+int platform_cd_read_status(void)
+{
+   if (read_state.failed)
+   {
+      return -1;
+   }
+
+   return read_state.active ? read_state.remaining : 0;
+}
+
+// The data shows up all at once when the read completes
+static void finish_read(void)
+{
+   size_t bytes = (size_t)read_state.count * PLATFORM_CD_SECTOR_SIZE;
+   FILE *handle = fopen(read_state.file->source, "rb");
+
+   memset(read_state.buffer, 0, bytes);
+   read_state.active = false;
+
+   if (!handle)
+   {
+      read_state.failed = true;
+      return;
+   }
+
+   fseek(handle, read_state.offset, SEEK_SET);
+   fread(read_state.buffer, 1, bytes, handle);
+   fclose(handle);
+}
+
+void cd_image_tick(void)
+{
+   if (!read_state.active)
+   {
+      return;
+   }
+
+   if (read_state.delay > 0)
+   {
+      read_state.delay--;
+      return;
+   }
+
+   read_state.remaining -= SECTORS_PER_FRAME;
+   if (read_state.remaining <= 0)
+   {
+      read_state.remaining = 0;
+      finish_read();
+   }
+}
@@ -0,0 +1,8 @@
+#ifndef CD_IMAGE_H
+#define CD_IMAGE_H
+
+// Host stand-in for the CD-ROM drive, implements the platform_cd_*()
+// functions. Advances the read in progress, called once per vblank.
+void cd_image_tick(void);
+
+#endif // CD_IMAGE_H
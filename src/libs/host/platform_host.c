@@ -0,0 +1,688 @@
+/**
+ * @file platform_host.c
+ * @brief Headless platform layer for running the game on a desktop machine
+ *
+ * Implements platform.h (and the data-only psxgpu helpers) without any
+ * hardware: OTs are rasterized by soft_gpu.c instead of being sent to a GPU,
+ * vblanks happen whenever the game waits for one, and the game runs as fast
+ * as the host allows. Build with `make host`.
+ *
+ * Environment variables:
+ * - HOST_FRAMES: number of vblanks to run before exiting (default 600)
+ * - HOST_STATS: when set, print the soft GPU statistics of every drawn OT
+ * - HOST_PAL: when set, report a PAL console (vblanks still take no time)
+ * - HOST_CAPTURE: comma separated list of frames (1 = first OT drawn) to
+ *   capture
+ * - HOST_DUMP_DIR: write captured frames there as frame_NNNNN.png, along with
+ *   the whole VRAM as vram_NNNNN.png
+ * - HOST_GOLDEN_DIR: compare captured frames with the frame_NNNNN.png files
+ *   there; the process exits with status 1 if any of them differ
+ * - HOST_TRACE_FILE: GPU trace output (see gpu_trace.h), written when
+ *   HOST_TRACE_FRAMES frames are requested, after skipping HOST_TRACE_SKIP
+ * - HOST_ISO_XML: the iso.xml the CD-ROM files are taken from, see cd_image.c
+ * - HOST_SAVE_DIR: where memory card files are read and written; without it
+ *   there is no memory card
+ * - HOST_INPUT_RECORD: record the pads for that many syncs from the start and
+ *   save the recording (see input_record.h). A recording still running on
+ *   exit is saved.
+ * - HOST_INPUT_PLAYBACK: when set, play back the recording saved in
+ *   HOST_SAVE_DIR, like a console build with INPUT_PLAYBACK_AT_BOOT
+ * - HOST_LATENCY: when set, measure input latency from the start (see
+ *   input_latency.h) and print the report on exit
+ * - HOST_ANALOG: when set, the scripted pad is a DualShock in analog mode
+ *   (id 0x73) with centered sticks instead of a digital pad
+ * - HOST_MULTITAP: when set and the SIO pad driver is selected, port 1 has a
+ *   multitap with the scripted pad in slot A and an idle digital pad in slot
+ *   B, sent through sio_pad_store_reply() like the driver's replies
+ *
+ * On exit a summary is printed: frames, wall time, frame rate and per-OT
+ * averages of the soft GPU statistics.
+ *
+ * The PSn00bSDK font is not available on the host, so platform_load_font()
+ * uploads generated glyphs instead: a box with a per-character bit pattern,
+ * enough to tell text apart in golden frames.
+ *
+ * Pads: port 1 holds CIRCLE for the first frames to leave the menu, then both
+ * ports report no controller so the AI plays both paddles. With the SIO pad
+ * driver selected, the script updates the buffers on platform_poll_pads()
+ * (PAD_POLL_ON_DEMAND) or at every vblank, then calls the pad callback.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "../platform.h"
+#include "../gpu_trace.h"
+#include "../input_record.h"
+#include "../input_latency.h"
+#include "../sio_pad.h"
+#include "soft_gpu.h"
+#include "cd_image.h"
+#include "png_io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_FRAMES 600
+
+// Nanoseconds per NTSC scanline, used to fake the hblank counter
+#define HBLANK_NS 63556
+
+// Frames pad 1 keeps CIRCLE held, it is released on the next one. The menu
+// only reacts once the textures streamed from the CD (cd_image.c) are in.
+#define START_PRESS_FRAMES 30
+
+// Multitap reply: address byte, 0x80, 0x5a, then an 8 byte frame per slot
+#define TAP_REPLY_SIZE (3 + 4 * 8)
+
+#define MAX_CAPTURES 64
+#define MAX_CAPTURE_PIXELS (SOFT_GPU_VRAM_WIDTH * SOFT_GPU_VRAM_HEIGHT)
+
+static void (*draw_callback)(void) = NULL;
+static void (*vsync_callback)(void) = NULL;
+static PlatformCallback pad_callback = NULL;
+static bool pad_callback_supported = false;
+static bool pads_on_demand = false;
+static bool multitap = false;
+static bool analog = false;
+static uint32_t vblank_count = 0;
+static uint32_t frame_limit = DEFAULT_FRAMES;
+static struct timespec start_time;
+
+static uint32_t ots_drawn = 0;
+static SoftGpuStats stats_total;
+static uint32_t peak_cycles = 0;
+static bool print_stats = false;
+static bool pal = false;
+
+static uint32_t capture_frames[MAX_CAPTURES];
+static int capture_count = 0;
+static const char *dump_dir = NULL;
+static const char *golden_dir = NULL;
+static int golden_failures = 0;
+
+static const char *trace_path = NULL;
+static const char *save_dir = NULL;
+static FILE *trace_file = NULL;
+
+static PADTYPE *pads[2] = {NULL, NULL};
+static int pad_buffer_length = 0;
+
+static uint16_t font_tpage = 0;
+static uint16_t font_clut = 0;
+
+static double elapsed_seconds(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (double)(now.tv_sec - start_time.tv_sec) + (now.tv_nsec - start_time.tv_nsec) / 1e9;
+}
+
+static void print_summary(void)
+{
+   double seconds = elapsed_seconds();
+
+   // A recording still running when the frame limit hits is saved as is
+   input_record_stop();
+   input_latency_stop();
+
+   printf("host: %u frames in %.3f s (%.1f frames/s)\n",
+          (unsigned)vblank_count, seconds, seconds > 0 ? vblank_count / seconds : 0.0);
+   if (ots_drawn)
+   {
+      double n = ots_drawn;
+
+      printf("host: %u OTs drawn, per OT: %.1f packets, %.1f words, %.1f tiles, %.1f sprites, %.1f fills\n",
+             (unsigned)ots_drawn, stats_total.packets / n, stats_total.words / n,
+             stats_total.tiles / n, stats_total.sprites / n, stats_total.fills / n);
+      printf("host: %.0f pixels drawn (%.2fx overdraw), %.1f state changes, %.0f GPU cycles (peak %u)\n",
+             stats_total.pixels_drawn / n,
+             stats_total.pixels_touched ? (double)stats_total.pixels_drawn / stats_total.pixels_touched : 0.0,
+             stats_total.state_changes / n, stats_total.estimated_cycles / n, (unsigned)peak_cycles);
+      if (stats_total.unsupported)
+      {
+         printf("host: %u unsupported GPU commands skipped\n", (unsigned)stats_total.unsupported);
+      }
+   }
+   if (golden_dir)
+   {
+      printf("host: %d of %d captured frames differ from %s\n", golden_failures, capture_count, golden_dir);
+   }
+}
+
+// Port 1 as a multitap would answer the SIO pad driver
+static void update_multitap(void)
+{
+   uint8_t reply[TAP_REPLY_SIZE];
+
+   memset(reply, 0xff, sizeof(reply));
+   reply[1] = 0x80;
+   reply[2] = 0x5a;
+
+   // Slot A: the scripted pad
+   if (vblank_count <= START_PRESS_FRAMES)
+   {
+      reply[3] = analog ? 0x73 : 0x41;
+      reply[4] = 0x5a;
+      reply[6] = (vblank_count < START_PRESS_FRAMES) ? (uint8_t)~0x20 : 0xff;
+      if (analog)
+      {
+         memset(&reply[7], 0x80, 4);
+      }
+   }
+
+   // Slot B: a digital pad nobody touches
+   reply[11] = 0x41;
+   reply[12] = 0x5a;
+
+   sio_pad_store_reply((uint8_t *)pads[0], pad_buffer_length, reply, TAP_REPLY_SIZE);
+}
+
+// Scripted stand-in for the BIOS pad driver, see the file comment.
+static void update_pads(void)
+{
+   for (int i = 0; i < 2; i++)
+   {
+      if (!pads[i])
+      {
+         continue;
+      }
+
+      if (i == 0 && multitap && pad_callback_supported)
+      {
+         update_multitap();
+      }
+      else if (i == 0 && vblank_count <= START_PRESS_FRAMES)
+      {
+         pads[i]->stat = 0;
+         pads[i]->type = analog ? 0x7 : 0x4;
+         pads[i]->len = analog ? 3 : 1;
+         pads[i]->btn = (vblank_count < START_PRESS_FRAMES) ? (uint16_t)~0x2000 : 0xffff;
+         if (analog)
+         {
+            pads[i]->rs_x = pads[i]->rs_y = pads[i]->ls_x = pads[i]->ls_y = 0x80;
+         }
+      }
+      else
+      {
+         pads[i]->stat = 0xff;
+      }
+   }
+
+   if (pad_callback)
+   {
+      pad_callback();
+   }
+}
+
+// One simulated vblank
+static void tick(void)
+{
+   vblank_count++;
+   if (!pads_on_demand)
+   {
+      update_pads();
+   }
+   cd_image_tick();
+
+   if (vsync_callback)
+   {
+      vsync_callback();
+   }
+
+   if (vblank_count >= frame_limit)
+   {
+      exit(golden_failures ? 1 : 0);
+   }
+}
+
+void platform_init_graphics(void)
+{
+   const char *frames = getenv("HOST_FRAMES");
+
+   if (frames)
+   {
+      frame_limit = (uint32_t)strtoul(frames, NULL, 10);
+   }
+
+   print_stats = getenv("HOST_STATS") != NULL;
+   pal = getenv("HOST_PAL") != NULL;
+   dump_dir = getenv("HOST_DUMP_DIR");
+   golden_dir = getenv("HOST_GOLDEN_DIR");
+
+   const char *capture = getenv("HOST_CAPTURE");
+   while (capture && *capture && capture_count < MAX_CAPTURES)
+   {
+      char *end;
+
+      capture_frames[capture_count++] = (uint32_t)strtoul(capture, &end, 10);
+      capture = (*end == ',') ? end + 1 : NULL;
+   }
+
+   trace_path = getenv("HOST_TRACE_FILE");
+   if (trace_path && getenv("HOST_TRACE_FRAMES"))
+   {
+      const char *skip = getenv("HOST_TRACE_SKIP");
+
+      gpu_trace_request(skip ? atoi(skip) : 0, atoi(getenv("HOST_TRACE_FRAMES")));
+   }
+
+   save_dir = getenv("HOST_SAVE_DIR");
+   if (getenv("HOST_INPUT_PLAYBACK"))
+   {
+      input_playback_start(INPUT_RECORD_FILE);
+   }
+   if (getenv("HOST_INPUT_RECORD"))
+   {
+      input_record_start(0xff, (uint32_t)atoi(getenv("HOST_INPUT_RECORD")));
+   }
+   multitap = getenv("HOST_MULTITAP") != NULL;
+   analog = getenv("HOST_ANALOG") != NULL;
+   if (getenv("HOST_LATENCY"))
+   {
+      input_latency_start();
+   }
+
+   soft_gpu_reset();
+
+   clock_gettime(CLOCK_MONOTONIC, &start_time);
+   atexit(print_summary);
+}
+
+// Same VRAM layout as the PSn00bSDK font: 16x6 glyphs of 8x8 4-bit texels
+// at (x, y), CLUT at (x, y + 128).
+void platform_load_font(int x, int y)
+{
+   static uint16_t texels[48][32];
+   static uint16_t clut[16] = {0x0000, 0x7fff};
+
+   memset(texels, 0, sizeof(texels));
+
+   for (int c = 1; c < 96; c++)
+   {
+      int cell_x = (c % 16) * 8;
+      int cell_y = (c / 16) * 8;
+
+      for (int v = 0; v < 7; v++)
+      {
+         for (int u = 0; u < 6; u++)
+         {
+            bool border = (u == 0 || u == 5 || v == 0 || v == 6);
+            bool bit = (c >> ((v - 1) * 4 + (u - 1)) % 7) & 1;
+
+            if (border || bit)
+            {
+               int tx = cell_x + u;
+               texels[cell_y + v][tx / 4] |= (uint16_t)(1 << ((tx & 3) * 4));
+            }
+         }
+      }
+   }
+
+   RECT texture_rect = {(int16_t)x, (int16_t)y, 32, 48};
+   RECT clut_rect = {(int16_t)x, (int16_t)(y + 128), 16, 1};
+
+   soft_gpu_load_image(&texture_rect, (const uint32_t *)texels);
+   soft_gpu_load_image(&clut_rect, (const uint32_t *)clut);
+
+   font_tpage = getTPage(0, 0, x, y);
+   font_clut = getClut(x, y + 128);
+}
+
+void platform_load_image(const RECT *rect, const uint32_t *data)
+{
+   soft_gpu_load_image(rect, data);
+}
+
+void platform_enable_display(void)
+{
+}
+
+void platform_put_display(const DISPENV *env)
+{
+   (void)env;
+}
+
+void platform_clear_ot(uint32_t *ot, int length)
+{
+   // Same layout as ClearOTagR(): every entry links to the previous one and
+   // the first one terminates the list.
+   for (int i = length - 1; i > 0; i--)
+   {
+      ot[i] = (uint32_t)(uintptr_t)&ot[i - 1] & 0xffffff;
+   }
+   termPrim(&ot[0]);
+}
+
+static void accumulate_stats(const SoftGpuStats *stats)
+{
+   stats_total.packets += stats->packets;
+   stats_total.words += stats->words;
+   stats_total.fills += stats->fills;
+   stats_total.tiles += stats->tiles;
+   stats_total.sprites += stats->sprites;
+   stats_total.state_changes += stats->state_changes;
+   stats_total.unsupported += stats->unsupported;
+   stats_total.pixels_drawn += stats->pixels_drawn;
+   stats_total.pixels_touched += stats->pixels_touched;
+   stats_total.estimated_cycles += stats->estimated_cycles;
+
+   if (stats->estimated_cycles > peak_cycles)
+   {
+      peak_cycles = stats->estimated_cycles;
+   }
+
+   if (print_stats)
+   {
+      printf("frame %5u: %3u packets %4u words %3u tiles %3u sprites %u fills, "
+             "%6u px (%.2fx), %2u state, %7u cycles\n",
+             (unsigned)ots_drawn, (unsigned)stats->packets, (unsigned)stats->words,
+             (unsigned)stats->tiles, (unsigned)stats->sprites, (unsigned)stats->fills,
+             (unsigned)stats->pixels_drawn,
+             stats->pixels_touched ? (double)stats->pixels_drawn / stats->pixels_touched : 0.0,
+             (unsigned)stats->state_changes, (unsigned)stats->estimated_cycles);
+   }
+}
+
+// Dump and/or compare the drawing area of a captured frame
+static void capture_frame(const DRAWENV *env)
+{
+   static uint8_t rgb[MAX_CAPTURE_PIXELS * 3];
+   static uint8_t golden[MAX_CAPTURE_PIXELS * 3];
+   char path[512];
+   int w = env->clip.w;
+   int h = env->clip.h;
+
+   soft_gpu_read_rgb(env->clip.x, env->clip.y, w, h, rgb);
+
+   if (dump_dir)
+   {
+      snprintf(path, sizeof(path), "%s/frame_%05u.png", dump_dir, (unsigned)ots_drawn);
+      if (!write_png_rgb(path, w, h, rgb))
+      {
+         fprintf(stderr, "host: can't write %s\n", path);
+      }
+
+      snprintf(path, sizeof(path), "%s/vram_%05u.png", dump_dir, (unsigned)ots_drawn);
+      soft_gpu_read_rgb(0, 0, SOFT_GPU_VRAM_WIDTH, SOFT_GPU_VRAM_HEIGHT, golden);
+      write_png_rgb(path, SOFT_GPU_VRAM_WIDTH, SOFT_GPU_VRAM_HEIGHT, golden);
+   }
+
+   if (golden_dir)
+   {
+      int golden_w, golden_h;
+      int different = 0;
+
+      snprintf(path, sizeof(path), "%s/frame_%05u.png", golden_dir, (unsigned)ots_drawn);
+      if (!read_png_rgb(path, &golden_w, &golden_h, golden, sizeof(golden)) ||
+          golden_w != w || golden_h != h)
+      {
+         fprintf(stderr, "host: frame %u: can't read a %dx%d golden from %s\n", (unsigned)ots_drawn, w, h, path);
+         golden_failures++;
+         return;
+      }
+
+      for (int i = 0; i < w * h; i++)
+      {
+         different += memcmp(&rgb[i * 3], &golden[i * 3], 3) != 0;
+      }
+
+      if (different)
+      {
+         fprintf(stderr, "host: frame %u: %d pixels differ from %s\n", (unsigned)ots_drawn, different, path);
+         golden_failures++;
+      }
+   }
+}
+
+void platform_draw_ot(const uint32_t *ot, DRAWENV *env)
+{
+   SoftGpuStats stats;
+
+   soft_gpu_draw_ot(ot, env, &stats);
+   ots_drawn++;
+   accumulate_stats(&stats);
+
+   for (int i = 0; i < capture_count; i++)
+   {
+      if (capture_frames[i] == ots_drawn)
+      {
+         capture_frame(env);
+      }
+   }
+
+   // Drawing is instantaneous here.
+   if (draw_callback)
+   {
+      draw_callback();
+   }
+}
+
+void platform_draw_sync(void)
+{
+}
+
+void platform_set_draw_callback(void (*callback)(void))
+{
+   draw_callback = callback;
+}
+
+void platform_vsync(void)
+{
+   tick();
+}
+
+PlatformCallback platform_set_vsync_callback(PlatformCallback callback)
+{
+   PlatformCallback previous = vsync_callback;
+
+   vsync_callback = callback;
+   return previous;
+}
+
+uint32_t platform_vblank_count(void)
+{
+   return vblank_count;
+}
+
+uint16_t platform_hblank_ticks(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint16_t)(((uint64_t)now.tv_sec * 1000000000u + now.tv_nsec) / HBLANK_NS);
+}
+
+bool platform_is_pal(void)
+{
+   return pal;
+}
+
+void platform_idle(void)
+{
+   tick();
+}
+
+void platform_enter_critical(void)
+{
+}
+
+void platform_exit_critical(void)
+{
+}
+
+void platform_init_pads(uint8_t *port0, uint8_t *port1, int length)
+{
+   memset(port0, 0xff, length);
+   memset(port1, 0xff, length);
+   pads[0] = (PADTYPE *)port0;
+   pads[1] = (PADTYPE *)port1;
+   pad_buffer_length = length;
+   update_pads();
+}
+
+void platform_use_sio_pad_driver(int poll_line)
+{
+   pads_on_demand = poll_line == PAD_POLL_ON_DEMAND;
+   pad_callback_supported = true;
+}
+
+void platform_poll_pads(void)
+{
+   if (pads_on_demand)
+   {
+      update_pads();
+   }
+}
+
+bool platform_set_pad_callback(PlatformCallback callback)
+{
+   if (!pad_callback_supported)
+   {
+      return false;
+   }
+
+   pad_callback = callback;
+   return true;
+}
+
+// Interrupts take no time here
+uint32_t platform_measure_pad_cost(int frames)
+{
+   (void)frames;
+   return 0;
+}
+
+void platform_trace_write(const void *data, size_t length)
+{
+   if (!trace_file && trace_path)
+   {
+      trace_file = fopen(trace_path, "wb");
+      if (!trace_file)
+      {
+         fprintf(stderr, "host: can't write %s\n", trace_path);
+         trace_path = NULL;
+      }
+   }
+
+   if (trace_file)
+   {
+      fwrite(data, 1, length, trace_file);
+   }
+}
+
+static bool save_path(const char *name, char *path, size_t size)
+{
+   if (!save_dir)
+   {
+      return false;
+   }
+
+   snprintf(path, size, "%s/%s", save_dir, name);
+   return true;
+}
+
+bool platform_save_file(const char *name, const void *data, size_t length)
+{
+   char path[512];
+   FILE *file;
+
+   if (!save_path(name, path, sizeof(path)) || !(file = fopen(path, "wb")))
+   {
+      return false;
+   }
+
+   bool ok = fwrite(data, 1, length, file) == length;
+
+   return fclose(file) == 0 && ok;
+}
+
+size_t platform_load_file(const char *name, void *buffer, size_t capacity)
+{
+   char path[512];
+   FILE *file;
+
+   if (!save_path(name, path, sizeof(path)) || !(file = fopen(path, "rb")))
+   {
+      return 0;
+   }
+
+   size_t length = fread(buffer, 1, capacity, file);
+
+   fclose(file);
+   return length;
+}
+
+/* Data-only psxgpu helpers */
+
+DRAWENV *SetDefDrawEnv(DRAWENV *env, int x, int y, int w, int h)
+{
+   memset(env, 0, sizeof(*env));
+   setRECT(&(env->clip), x, y, w, h);
+   env->dfe = 1;
+   return env;
+}
+
+DISPENV *SetDefDispEnv(DISPENV *env, int x, int y, int w, int h)
+{
+   memset(env, 0, sizeof(*env));
+   setRECT(&(env->disp), x, y, w, h);
+   return env;
+}
+
+int GetTimInfo(const uint32_t *tim, TIM_IMAGE *info)
+{
+   if ((tim[0] & 0xffff) != 0x0010)
+   {
+      return 1;
+   }
+
+   const uint32_t *block = &tim[2];
+
+   info->mode = tim[1];
+   info->crect = NULL;
+   info->caddr = NULL;
+
+   // Each block: length in bytes (including this header), RECT, data
+   if (info->mode & 0x8)
+   {
+      info->crect = (RECT *)&block[1];
+      info->caddr = (uint32_t *)&block[3];
+      block += block[0] / 4;
+   }
+
+   info->prect = (RECT *)&block[1];
+   info->paddr = (uint32_t *)&block[3];
+
+   return 0;
+}
+
+char *FntSort(uint32_t *ot, char *pri, int x, int y, const char *text)
+{
+   SPRT_8 *sprt = (SPRT_8 *)pri;
+
+   for (; *text; text++, x += 8)
+   {
+      int c = (uint8_t)*text - 32;
+
+      if (c <= 0 || c >= 96)
+      {
+         continue;
+      }
+
+      setSprt8(sprt);
+      setRGB0(sprt, 128, 128, 128);
+      setXY0(sprt, x, y);
+      setUV0(sprt, (c % 16) * 8, (c / 16) * 8);
+      sprt->clut = font_clut;
+      addPrim(ot, sprt);
+      sprt++;
+   }
+
+   DR_TPAGE *tpage = (DR_TPAGE *)sprt;
+   setDrawTPage(tpage, 0, 0, font_tpage);
+   addPrim(ot, tpage);
+
+   return (char *)(tpage + 1);
+}
@@ -0,0 +1,248 @@
+/**
+ * @file png_io.c
+ * @brief Uncompressed PNG reader/writer for the host build's golden frames
+ *
+ * See png_io.h for the restrictions on readable files.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "png_io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Largest stored deflate block
+#define STORED_BLOCK_MAX 65535
+
+static const uint8_t png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+static uint32_t crc_table[256];
+static bool crc_table_ready = false;
+
+static uint32_t update_crc(uint32_t crc, const uint8_t *data, size_t length)
+{
+   if (!crc_table_ready)
+   {
+      for (uint32_t n = 0; n < 256; n++)
+      {
+         uint32_t c = n;
+         for (int k = 0; k < 8; k++)
+         {
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+         }
+         crc_table[n] = c;
+      }
+      crc_table_ready = true;
+   }
+
+   for (size_t i = 0; i < length; i++)
+   {
+      crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+   }
+
+   return crc;
+}
+
+static void put_be32(uint8_t *out, uint32_t value)
+{
+   out[0] = (uint8_t)(value >> 24);
+   out[1] = (uint8_t)(value >> 16);
+   out[2] = (uint8_t)(value >> 8);
+   out[3] = (uint8_t)value;
+}
+
+static uint32_t get_be32(const uint8_t *in)
+{
+   return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+static void write_chunk(FILE *file, const char *type, const uint8_t *data, size_t length)
+{
+   uint8_t header[8];
+   uint8_t footer[4];
+
+   put_be32(header, (uint32_t)length);
+   memcpy(&header[4], type, 4);
+
+   uint32_t crc = update_crc(0xffffffffu, (const uint8_t *)type, 4);
+   crc = update_crc(crc, data, length) ^ 0xffffffffu;
+   put_be32(footer, crc);
+
+   fwrite(header, 1, sizeof(header), file);
+   fwrite(data, 1, length, file);
+   fwrite(footer, 1, sizeof(footer), file);
+}
+
+bool write_png_rgb(const char *path, int w, int h, const uint8_t *rgb)
+{
+   FILE *file = fopen(path, "wb");
+
+   if (!file)
+   {
+      return false;
+   }
+
+   // Raw scanlines, each prefixed with filter type 0
+   size_t row_bytes = (size_t)w * 3 + 1;
+   size_t raw_length = row_bytes * h;
+   size_t blocks = (raw_length + STORED_BLOCK_MAX - 1) / STORED_BLOCK_MAX;
+   size_t zlib_length = 2 + raw_length + blocks * 5 + 4;
+   uint8_t *raw = malloc(raw_length);
+   uint8_t *zlib = malloc(zlib_length);
+
+   for (int y = 0; y < h; y++)
+   {
+      raw[y * row_bytes] = 0;
+      memcpy(&raw[y * row_bytes + 1], &rgb[(size_t)y * w * 3], (size_t)w * 3);
+   }
+
+   // zlib stream made of stored blocks, followed by the Adler-32 of the data
+   uint8_t *out = zlib;
+   uint32_t a = 1, b = 0;
+
+   *out++ = 0x78;
+   *out++ = 0x01;
+
+   for (size_t offset = 0; offset < raw_length; offset += STORED_BLOCK_MAX)
+   {
+      size_t length = raw_length - offset;
+
+      if (length > STORED_BLOCK_MAX)
+      {
+         length = STORED_BLOCK_MAX;
+      }
+
+      *out++ = (offset + length == raw_length) ? 1 : 0;
+      *out++ = (uint8_t)length;
+      *out++ = (uint8_t)(length >> 8);
+      *out++ = (uint8_t)~length;
+      *out++ = (uint8_t)(~length >> 8);
+      memcpy(out, &raw[offset], length);
+      out += length;
+   }
+
+   for (size_t i = 0; i < raw_length; i++)
+   {
+      a = (a + raw[i]) % 65521;
+      b = (b + a) % 65521;
+   }
+   put_be32(out, (b << 16) | a);
+
+   uint8_t ihdr[13];
+   put_be32(&ihdr[0], (uint32_t)w);
+   put_be32(&ihdr[4], (uint32_t)h);
+   ihdr[8] = 8;  // Bit depth
+   ihdr[9] = 2;  // Truecolor
+   ihdr[10] = 0; // Deflate
+   ihdr[11] = 0; // Adaptive filtering
+   ihdr[12] = 0; // No interlace
+
+   fwrite(png_signature, 1, sizeof(png_signature), file);
+   write_chunk(file, "IHDR", ihdr, sizeof(ihdr));
+   write_chunk(file, "IDAT", zlib, zlib_length);
+   write_chunk(file, "IEND", NULL, 0);
+
+   free(raw);
+   free(zlib);
+
+   return fclose(file) == 0;
+}
+
+bool read_png_rgb(const char *path, int *w, int *h, uint8_t *rgb, size_t max_bytes)
+{
+   FILE *file = fopen(path, "rb");
+
+   if (!file)
+   {
+      return false;
+   }
+
+   fseek(file, 0, SEEK_END);
+   long size = ftell(file);
+   fseek(file, 0, SEEK_SET);
+
+   uint8_t *data = malloc(size);
+   uint8_t *zlib = malloc(size);
+   size_t zlib_length = 0;
+   bool ok = fread(data, 1, size, file) == (size_t)size &&
+             size > 8 && !memcmp(data, png_signature, sizeof(png_signature));
+
+   fclose(file);
+
+   // Gather the IDAT chunks
+   *w = *h = 0;
+   for (long offset = 8; ok && offset + 12 <= size;)
+   {
+      uint32_t length = get_be32(&data[offset]);
+      const uint8_t *type = &data[offset + 4];
+      const uint8_t *body = &data[offset + 8];
+
+      if (offset + 12 + (long)length > size)
+      {
+         ok = false;
+         break;
+      }
+
+      if (!memcmp(type, "IHDR", 4))
+      {
+         *w = (int)get_be32(&body[0]);
+         *h = (int)get_be32(&body[4]);
+         ok = body[8] == 8 && body[9] == 2 && body[12] == 0;
+      }
+      else if (!memcmp(type, "IDAT", 4))
+      {
+         memcpy(&zlib[zlib_length], body, length);
+         zlib_length += length;
+      }
+
+      offset += 12 + length;
+   }
+
+   size_t row_bytes = (size_t)*w * 3;
+   ok = ok && row_bytes * *h <= max_bytes && zlib_length > 2;
+
+   // Inflate stored blocks only, and un-filter type 0 scanlines only
+   size_t in = 2;
+   size_t position = 0;
+   bool last = false;
+
+   while (ok && !last && in + 5 <= zlib_length)
+   {
+      last = zlib[in] & 1;
+      if ((zlib[in] >> 1) & 3)
+      {
+         ok = false;
+         break;
+      }
+
+      size_t length = zlib[in + 1] | (zlib[in + 2] << 8);
+      in += 5;
+
+      for (size_t i = 0; i < length && in < zlib_length; i++, in++, position++)
+      {
+         size_t row = position / (row_bytes + 1);
+         size_t column = position % (row_bytes + 1);
+
+         if (row >= (size_t)*h)
+         {
+            break;
+         }
+         if (column == 0)
+         {
+            ok = ok && zlib[in] == 0;
+         }
+         else
+         {
+            rgb[row * row_bytes + column - 1] = zlib[in];
+         }
+      }
+   }
+
+   ok = ok && position == (row_bytes + 1) * *h;
+
+   free(data);
+   free(zlib);
+
+   return ok;
+}
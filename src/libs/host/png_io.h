@@ -0,0 +1,17 @@
+#ifndef PNG_IO_H
+#define PNG_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Minimal 8-bit RGB PNG support for golden frames. Files are written with
+// uncompressed deflate blocks and only that form can be read back, so goldens
+// have to come from write_png_rgb() (e.g. HOST_DUMP_DIR), not an image editor.
+
+bool write_png_rgb(const char *path, int w, int h, const uint8_t *rgb);
+
+// Reads an image written by write_png_rgb(). rgb must hold max_bytes bytes.
+bool read_png_rgb(const char *path, int *w, int *h, uint8_t *rgb, size_t max_bytes);
+
+#endif // PNG_IO_H
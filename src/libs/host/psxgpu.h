@@ -0,0 +1,134 @@
+#ifndef HOST_PSXGPU_H
+#define HOST_PSXGPU_H
+
+// Host stand-in for the parts of PSn00bSDK's psxgpu.h that only describe data:
+// the environment/primitive structures and the packet macros, with the same
+// layout as on the PS1. Packet links hold 24-bit addresses like on the real
+// hardware, so the host build is linked as a non-PIE executable to keep every
+// packet buffer (all of them are static) in the low 16 MB.
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct
+{
+   int16_t x, y, w, h;
+} RECT;
+
+typedef struct
+{
+   uint32_t tag;
+   uint32_t code[15];
+} DR_ENV;
+
+typedef struct
+{
+   RECT clip;
+   int16_t ofs[2];
+   RECT tw;
+   uint16_t tpage;
+   uint8_t dtd, dfe, isbg, r0, g0, b0;
+   DR_ENV dr_env;
+} DRAWENV;
+
+typedef struct
+{
+   RECT disp, screen;
+   uint8_t isinter, isrgb24, reverse, _reserved;
+} DISPENV;
+
+typedef struct
+{
+   uint32_t mode;
+   RECT *crect;
+   uint32_t *caddr;
+   RECT *prect;
+   uint32_t *paddr;
+} TIM_IMAGE;
+
+typedef struct
+{
+   uint32_t tag;
+   uint8_t r0, g0, b0, code;
+   int16_t x0, y0;
+   int16_t w, h;
+} TILE;
+
+typedef struct
+{
+   uint32_t tag;
+   uint8_t r0, g0, b0, code;
+   uint16_t x0, y0;
+   uint16_t w, h;
+} FILL;
+
+typedef struct
+{
+   uint32_t tag;
+   uint8_t r0, g0, b0, code;
+   int16_t x0, y0;
+   uint8_t u0, v0;
+   uint16_t clut;
+   int16_t w, h;
+} SPRT;
+
+typedef struct
+{
+   uint32_t tag;
+   uint8_t r0, g0, b0, code;
+   int16_t x0, y0;
+   uint8_t u0, v0;
+   uint16_t clut;
+} SPRT_8;
+
+typedef SPRT_8 SPRT_16;
+
+typedef struct
+{
+   uint32_t tag;
+   uint32_t code[1];
+} DR_TPAGE;
+
+#define MODE_NTSC 0
+#define MODE_PAL 1
+
+#define setlen(p, _len) (((uint8_t *)(p))[3] = (uint8_t)(_len))
+#define setaddr(p, _addr) (((uint32_t *)(p))[0] = (((uint32_t *)(p))[0] & 0xff000000) | ((uint32_t)(uintptr_t)(_addr) & 0xffffff))
+#define setcode(p, _code) (((uint8_t *)(p))[7] = (uint8_t)(_code))
+#define getlen(p) (((uint8_t *)(p))[3])
+#define getaddr(p) (((uint32_t *)(p))[0] & 0xffffff)
+#define getcode(p) (((uint8_t *)(p))[7])
+
+#define nextPrim(p) ((void *)(uintptr_t)getaddr(p))
+#define isendprim(p) (getaddr(p) == 0xffffff)
+#define addPrim(ot, p) (setaddr(p, getaddr(ot)), setaddr(ot, p))
+#define addPrims(ot, p0, p1) (setaddr(p1, getaddr(ot)), setaddr(ot, p0))
+#define catPrim(p0, p1) setaddr(p0, p1)
+#define termPrim(p) setaddr(p, 0xffffff)
+
+#define setRGB0(p, r, g, b) ((p)->r0 = (r), (p)->g0 = (g), (p)->b0 = (b))
+#define setXY0(p, _x0, _y0) ((p)->x0 = (_x0), (p)->y0 = (_y0))
+#define setWH(p, _w, _h) ((p)->w = (_w), (p)->h = (_h))
+#define setUV0(p, _u0, _v0) ((p)->u0 = (_u0), (p)->v0 = (_v0))
+#define setRECT(r, _x, _y, _w, _h) ((r)->x = (_x), (r)->y = (_y), (r)->w = (_w), (r)->h = (_h))
+
+#define getClut(x, y) ((uint16_t)(((y) << 6) | (((x) >> 4) & 0x3f)))
+#define setClut(p, x, y) ((p)->clut = getClut(x, y))
+#define getTPage(tp, abr, x, y) \
+   ((uint16_t)((((x) & 0x3ff) >> 6) | (((y) & 0x100) >> 4) | (((abr) & 3) << 5) | (((tp) & 3) << 7) | (((y) & 0x200) << 2)))
+
+#define setFill(p) (setlen(p, 3), setcode(p, 0x02))
+#define setTile(p) (setlen(p, 3), setcode(p, 0x60))
+#define setSprt(p) (setlen(p, 4), setcode(p, 0x64))
+#define setSprt8(p) (setlen(p, 3), setcode(p, 0x74))
+#define setSprt16(p) (setlen(p, 3), setcode(p, 0x7c))
+#define setSemiTrans(p, abe) ((abe) ? (getcode(p) |= 2) : (getcode(p) &= ~2))
+#define setDrawTPage(p, _dfe, _dtd, _tpage) \
+   (setlen(p, 1), (p)->code[0] = 0xe1000000 | ((_tpage) & 0x9ff) | ((_dtd) << 9) | ((_dfe) << 10))
+
+DRAWENV *SetDefDrawEnv(DRAWENV *env, int x, int y, int w, int h);
+DISPENV *SetDefDispEnv(DISPENV *env, int x, int y, int w, int h);
+int GetTimInfo(const uint32_t *tim, TIM_IMAGE *info);
+char *FntSort(uint32_t *ot, char *pri, int x, int y, const char *text);
+
+#endif // HOST_PSXGPU_H
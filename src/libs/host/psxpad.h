@@ -0,0 +1,19 @@
+#ifndef HOST_PSXPAD_H
+#define HOST_PSXPAD_H
+
+// Host stand-in for PSn00bSDK's psxpad.h, see host/psxgpu.h
+
+#include <stdint.h>
+
+typedef struct
+{
+   uint8_t stat;
+   uint8_t len : 4;
+   uint8_t type : 4;
+   uint16_t btn;
+   uint8_t rs_x, rs_y;
+   uint8_t ls_x, ls_y;
+   uint8_t press[12];
+} PADTYPE;
+
+#endif // HOST_PSXPAD_H
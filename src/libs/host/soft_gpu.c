@@ -0,0 +1,543 @@
+/**
+ * @file soft_gpu.c
+ * @brief Software rasterizer for the packet chains built by the game
+ *
+ * Walks an OT the same way the GPU's DMA does and interprets the GP0 commands
+ * in every packet, drawing into a 1024x512 16-bit VRAM image. Covers what the
+ * game emits:
+ * - rectangle fills (0x02) and the DRAWENV background clear
+ * - TILE / TILE_1 / TILE_8 / TILE_16, opaque or semi-transparent
+ * - SPRT / SPRT_8 / SPRT_16 with 4-bit, 8-bit and 15-bit textures, raw or
+ *   modulated, including the FntSort() glyphs
+ * - texpage, texture window (ignored), drawing area, offset and mask settings
+ *
+ * Polygons, lines and VRAM transfer commands are skipped and counted as
+ * unsupported. Dithering and texture windows are not emulated, so output is
+ * close to, but not bit-exact with, real hardware; it is meant for comparing
+ * frames of this build against each other.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "soft_gpu.h"
+#include <string.h>
+
+// Rough GPU cost model, in GPU clocks. Real timings depend on cache hits and
+// alignment; these only need to rank frames against each other.
+#define WORD_CYCLES 1
+#define FILL_PIXEL_CYCLES_DIV 2
+#define FLAT_PIXEL_CYCLES 1
+#define TEXTURED_PIXEL_CYCLES 2
+#define BLEND_PIXEL_CYCLES 1
+
+static uint16_t vram[SOFT_GPU_VRAM_HEIGHT][SOFT_GPU_VRAM_WIDTH];
+
+// Frame stamp per pixel, used to count distinct pixels written per OT
+static uint16_t touched[SOFT_GPU_VRAM_HEIGHT][SOFT_GPU_VRAM_WIDTH];
+static uint16_t touch_stamp = 0;
+
+// Drawing state (GP0 0xe1 - 0xe6)
+static uint32_t texpage = 0;
+static uint32_t texwindow = 0;
+static int area_x1 = 0, area_y1 = 0, area_x2 = 0, area_y2 = 0;
+static int offset_x = 0, offset_y = 0;
+static bool set_mask = false;
+static bool check_mask = false;
+
+static SoftGpuStats *current_stats;
+
+void soft_gpu_reset(void)
+{
+   memset(vram, 0, sizeof(vram));
+   memset(touched, 0, sizeof(touched));
+   touch_stamp = 0;
+   texpage = 0;
+   texwindow = 0;
+   area_x1 = area_y1 = area_x2 = area_y2 = 0;
+   offset_x = offset_y = 0;
+   set_mask = check_mask = false;
+}
+
+uint16_t *soft_gpu_vram(void)
+{
+   return &vram[0][0];
+}
+
+void soft_gpu_load_image(const RECT *rect, const uint32_t *data)
+{
+   const uint16_t *pixels = (const uint16_t *)data;
+
+   for (int y = 0; y < rect->h; y++)
+   {
+      for (int x = 0; x < rect->w; x++)
+      {
+         vram[(rect->y + y) & 511][(rect->x + x) & 1023] = *pixels++;
+      }
+   }
+}
+
+static inline uint16_t rgb24_to_15(uint32_t rgb)
+{
+   return (uint16_t)(((rgb >> 3) & 0x1f) | (((rgb >> 11) & 0x1f) << 5) | (((rgb >> 19) & 0x1f) << 10));
+}
+
+static inline int sign_extend(uint32_t value, int bits)
+{
+   int shift = 32 - bits;
+   return (int32_t)(value << shift) >> shift;
+}
+
+static void count_touch(int x, int y)
+{
+   current_stats->pixels_drawn++;
+   if (touched[y][x] != touch_stamp)
+   {
+      touched[y][x] = touch_stamp;
+      current_stats->pixels_touched++;
+   }
+}
+
+// Semi-transparency, per 5-bit channel: B/2+F/2, B+F, B-F, B+F/4
+static uint16_t blend(uint16_t back, uint16_t front, int mode)
+{
+   uint16_t result = 0;
+
+   for (int shift = 0; shift < 15; shift += 5)
+   {
+      int b = (back >> shift) & 0x1f;
+      int f = (front >> shift) & 0x1f;
+      int c;
+
+      switch (mode)
+      {
+      case 0:
+         c = (b + f) >> 1;
+         break;
+      case 1:
+         c = b + f;
+         break;
+      case 2:
+         c = b - f;
+         break;
+      default:
+         c = b + (f >> 2);
+         break;
+      }
+
+      c = c < 0 ? 0 : (c > 31 ? 31 : c);
+      result |= (uint16_t)(c << shift);
+   }
+
+   return result;
+}
+
+static void write_pixel(int x, int y, uint16_t color, bool semi)
+{
+   uint16_t *pixel = &vram[y][x];
+
+   if (check_mask && (*pixel & 0x8000))
+   {
+      return;
+   }
+
+   if (semi)
+   {
+      color = (color & 0x8000) | blend(*pixel, color, (texpage >> 5) & 3);
+   }
+
+   *pixel = color | (set_mask ? 0x8000 : 0);
+   count_touch(x, y);
+}
+
+static uint16_t fetch_texel(int u, int v, uint16_t clut)
+{
+   int base_x = (texpage & 0xf) * 64;
+   int base_y = ((texpage >> 4) & 1) * 256;
+   int clut_x = (clut & 0x3f) * 16;
+   int clut_y = (clut >> 6) & 511;
+   int y = (base_y + v) & 511;
+
+   switch ((texpage >> 7) & 3)
+   {
+   case 0:
+   {
+      uint16_t word = vram[y][(base_x + u / 4) & 1023];
+      return vram[clut_y][(clut_x + ((word >> ((u & 3) * 4)) & 0xf)) & 1023];
+   }
+   case 1:
+   {
+      uint16_t word = vram[y][(base_x + u / 2) & 1023];
+      return vram[clut_y][(clut_x + ((word >> ((u & 1) * 8)) & 0xff)) & 1023];
+   }
+   default:
+      return vram[y][(base_x + u) & 1023];
+   }
+}
+
+static uint16_t modulate(uint16_t texel, uint32_t rgb)
+{
+   uint16_t result = texel & 0x8000;
+
+   for (int i = 0; i < 3; i++)
+   {
+      int c = (((texel >> (i * 5)) & 0x1f) * (int)((rgb >> (i * 8)) & 0xff)) >> 7;
+      result |= (uint16_t)((c > 31 ? 31 : c) << (i * 5));
+   }
+
+   return result;
+}
+
+// Rectangle commands 0x60 - 0x7f
+static void draw_rectangle(const uint32_t *words)
+{
+   uint32_t command = words[0] >> 24;
+   bool textured = command & 0x04;
+   bool raw = command & 0x01;
+   bool semi = command & 0x02;
+   uint32_t rgb = words[0] & 0xffffff;
+   int x = sign_extend(words[1] & 0xffff, 11) + offset_x;
+   int y = sign_extend(words[1] >> 16, 11) + offset_y;
+   int u0 = 0, v0 = 0;
+   uint16_t clut = 0;
+   int w, h;
+
+   if (textured)
+   {
+      u0 = words[2] & 0xff;
+      v0 = (words[2] >> 8) & 0xff;
+      clut = (uint16_t)(words[2] >> 16);
+   }
+
+   switch ((command >> 3) & 3)
+   {
+   case 0:
+      w = words[textured ? 3 : 2] & 0x3ff;
+      h = (words[textured ? 3 : 2] >> 16) & 0x1ff;
+      break;
+   case 1:
+      w = h = 1;
+      break;
+   case 2:
+      w = h = 8;
+      break;
+   default:
+      w = h = 16;
+      break;
+   }
+
+   if (textured)
+   {
+      current_stats->sprites++;
+   }
+   else
+   {
+      current_stats->tiles++;
+   }
+
+   uint16_t flat = rgb24_to_15(rgb);
+   int pixels = 0;
+
+   for (int row = 0; row < h; row++)
+   {
+      int py = y + row;
+
+      if (py < area_y1 || py > area_y2)
+      {
+         continue;
+      }
+
+      for (int col = 0; col < w; col++)
+      {
+         int px = x + col;
+
+         if (px < area_x1 || px > area_x2)
+         {
+            continue;
+         }
+
+         if (!textured)
+         {
+            write_pixel(px, py, flat, semi);
+            pixels++;
+            continue;
+         }
+
+         uint16_t texel = fetch_texel((u0 + col) & 0xff, (v0 + row) & 0xff, clut);
+
+         // Texel 0x0000 is fully transparent
+         if (!texel)
+         {
+            continue;
+         }
+
+         write_pixel(px, py, raw ? texel : modulate(texel, rgb), semi && (texel & 0x8000));
+         pixels++;
+      }
+   }
+
+   current_stats->estimated_cycles += pixels * ((textured ? TEXTURED_PIXEL_CYCLES : FLAT_PIXEL_CYCLES) +
+                                                (semi ? BLEND_PIXEL_CYCLES : 0));
+}
+
+// GP0 0x02: fills ignore the drawing area, offset and mask, and work in
+// 16-pixel steps horizontally.
+static void fill_rectangle(int x, int y, int w, int h, uint32_t rgb)
+{
+   uint16_t color = rgb24_to_15(rgb);
+
+   x &= 0x3f0;
+   y &= 0x1ff;
+   w = ((w & 0x3ff) + 0xf) & ~0xf;
+   h &= 0x1ff;
+
+   for (int row = 0; row < h; row++)
+   {
+      for (int col = 0; col < w; col++)
+      {
+         int px = (x + col) & 1023;
+         int py = (y + row) & 511;
+
+         vram[py][px] = color;
+         count_touch(px, py);
+      }
+   }
+
+   current_stats->fills++;
+   current_stats->estimated_cycles += (uint32_t)(w * h) / FILL_PIXEL_CYCLES_DIV;
+}
+
+static void set_state(uint32_t *state, uint32_t value)
+{
+   if (*state != value)
+   {
+      *state = value;
+      current_stats->state_changes++;
+   }
+}
+
+static void set_draw_area(int x1, int y1, int x2, int y2)
+{
+   if (x1 != area_x1 || y1 != area_y1 || x2 != area_x2 || y2 != area_y2)
+   {
+      area_x1 = x1;
+      area_y1 = y1;
+      area_x2 = x2;
+      area_y2 = y2;
+      current_stats->state_changes++;
+   }
+}
+
+// Number of words used by a polygon or line command
+static int primitive_length(const uint32_t *words, int available)
+{
+   uint32_t command = words[0] >> 24;
+
+   if (command < 0x40)
+   {
+      int vertices = (command & 0x08) ? 4 : 3;
+      int per_vertex = 1 + ((command & 0x04) ? 1 : 0) + ((command & 0x10) ? 1 : 0);
+
+      return vertices * per_vertex + ((command & 0x10) ? 0 : 1);
+   }
+
+   if (!(command & 0x08))
+   {
+      return (command & 0x10) ? 4 : 3;
+   }
+
+   // Polylines run until the 0x5xxx5xxx terminator
+   for (int i = 1; i < available; i++)
+   {
+      if ((words[i] & 0xf000f000) == 0x50005000)
+      {
+         return i + 1;
+      }
+   }
+
+   return available;
+}
+
+int soft_gpu_command_length(const uint32_t *words, int available)
+{
+   uint32_t code = words[0] >> 24;
+
+   if (code == 0x00 || code == 0x01 || code == 0x1f || (code >= 0xe1 && code <= 0xe6))
+   {
+      return 1;
+   }
+   if (code == 0x02 || (code >= 0xc0 && code < 0xe0))
+   {
+      return 3;
+   }
+   if (code >= 0x20 && code < 0x60)
+   {
+      return primitive_length(words, available);
+   }
+   if (code >= 0x60 && code < 0x80)
+   {
+      return 2 + ((code & 0x04) ? 1 : 0) + (((code >> 3) & 3) ? 0 : 1);
+   }
+   if (code >= 0x80 && code < 0xa0)
+   {
+      return 4;
+   }
+   if (code >= 0xa0 && code < 0xc0 && available >= 3)
+   {
+      // CPU to VRAM transfer, followed by the pixel data
+      uint32_t pixels = (words[2] & 0xffff) * (words[2] >> 16);
+      return 3 + (int)((pixels + 1) / 2);
+   }
+
+   return 0;
+}
+
+// Interprets the commands of one packet
+static void execute_packet(const uint32_t *words, int length)
+{
+   int index = 0;
+
+   while (index < length)
+   {
+      const uint32_t *command = &words[index];
+      uint32_t code = command[0] >> 24;
+      int command_length = soft_gpu_command_length(command, length - index);
+
+      // Unknown commands: the rest of the packet can't be decoded reliably.
+      if (!command_length)
+      {
+         current_stats->unsupported++;
+         break;
+      }
+
+      if (code == 0x02)
+      {
+         fill_rectangle(command[1] & 0xffff, command[1] >> 16,
+                        command[2] & 0xffff, command[2] >> 16, command[0] & 0xffffff);
+      }
+      else if (code >= 0x60 && code < 0x80)
+      {
+         draw_rectangle(command);
+      }
+      else if (code == 0xe1)
+      {
+         set_state(&texpage, command[0] & 0xffffff);
+      }
+      else if (code == 0xe2)
+      {
+         set_state(&texwindow, command[0] & 0xffffff);
+      }
+      else if (code == 0xe3)
+      {
+         set_draw_area(command[0] & 0x3ff, (command[0] >> 10) & 0x1ff, area_x2, area_y2);
+      }
+      else if (code == 0xe4)
+      {
+         set_draw_area(area_x1, area_y1, command[0] & 0x3ff, (command[0] >> 10) & 0x1ff);
+      }
+      else if (code == 0xe5)
+      {
+         int x = sign_extend(command[0] & 0x7ff, 11);
+         int y = sign_extend((command[0] >> 11) & 0x7ff, 11);
+
+         if (x != offset_x || y != offset_y)
+         {
+            offset_x = x;
+            offset_y = y;
+            current_stats->state_changes++;
+         }
+      }
+      else if (code == 0xe6)
+      {
+         set_mask = command[0] & 1;
+         check_mask = command[0] & 2;
+      }
+      else if (code >= 0x20)
+      {
+         // Polygons, lines and VRAM transfers are not drawn
+         current_stats->unsupported++;
+      }
+
+      index += command_length;
+   }
+}
+
+void soft_gpu_begin(const DRAWENV *env, SoftGpuStats *stats)
+{
+   memset(stats, 0, sizeof(*stats));
+   current_stats = stats;
+
+   if (++touch_stamp == 0)
+   {
+      memset(touched, 0, sizeof(touched));
+      touch_stamp = 1;
+   }
+
+   // What DrawOTagEnv() sends before the OT itself
+   set_state(&texpage, env->tpage | (env->dtd << 9) | (env->dfe << 10));
+   set_draw_area(env->clip.x, env->clip.y, env->clip.x + env->clip.w - 1, env->clip.y + env->clip.h - 1);
+   offset_x = env->clip.x + env->ofs[0];
+   offset_y = env->clip.y + env->ofs[1];
+
+   if (env->isbg)
+   {
+      fill_rectangle(env->clip.x, env->clip.y, env->clip.w, env->clip.h,
+                     env->r0 | (env->g0 << 8) | ((uint32_t)env->b0 << 16));
+   }
+}
+
+void soft_gpu_execute(const uint32_t *words, int length)
+{
+   if (length)
+   {
+      current_stats->packets++;
+      current_stats->words += length;
+      current_stats->estimated_cycles += length * WORD_CYCLES;
+      execute_packet(words, length);
+   }
+}
+
+void soft_gpu_draw_ot(const uint32_t *ot, const DRAWENV *env, SoftGpuStats *stats)
+{
+   const uint32_t *packet = ot;
+
+   soft_gpu_begin(env, stats);
+
+   for (;;)
+   {
+      soft_gpu_execute(&packet[1], getlen(packet));
+
+      if (isendprim(packet))
+      {
+         break;
+      }
+      packet = (const uint32_t *)nextPrim(packet);
+   }
+}
+
+void soft_gpu_read_rgb(int x, int y, int w, int h, uint8_t *rgb)
+{
+   for (int row = 0; row < h; row++)
+   {
+      for (int col = 0; col < w; col++)
+      {
+         uint16_t pixel = vram[(y + row) & 511][(x + col) & 1023];
+
+         for (int i = 0; i < 3; i++)
+         {
+            int c = (pixel >> (i * 5)) & 0x1f;
+            *rgb++ = (uint8_t)((c << 3) | (c >> 2));
+         }
+      }
+   }
+}
+
+void soft_gpu_write_rgb(int x, int y, int w, int h, const uint8_t *rgb)
+{
+   for (int row = 0; row < h; row++)
+   {
+      for (int col = 0; col < w; col++, rgb += 3)
+      {
+         vram[(y + row) & 511][(x + col) & 1023] = (uint16_t)((rgb[0] >> 3) | ((rgb[1] >> 3) << 5) | ((rgb[2] >> 3) << 10));
+      }
+   }
+}
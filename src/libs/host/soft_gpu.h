@@ -0,0 +1,48 @@
+#ifndef SOFT_GPU_H
+#define SOFT_GPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "psxgpu.h"
+
+#define SOFT_GPU_VRAM_WIDTH 1024
+#define SOFT_GPU_VRAM_HEIGHT 512
+
+// Per-OT statistics gathered while rasterizing
+typedef struct
+{
+   uint32_t packets;       // Non-empty packets in the chain
+   uint32_t words;         // Packet words, excluding tags
+   uint32_t fills;         // GP0 0x02 rectangle fills
+   uint32_t tiles;         // Untextured rectangles
+   uint32_t sprites;       // Textured rectangles
+   uint32_t state_changes; // Texpage/area/offset commands that changed something
+   uint32_t unsupported;   // Commands that were skipped (polygons, lines...)
+
+   uint32_t pixels_drawn;     // Fill area, background clear included
+   uint32_t pixels_touched;   // Distinct pixels written
+   uint32_t estimated_cycles; // Rough GPU cost, only meaningful to compare frames
+} SoftGpuStats;
+
+void soft_gpu_reset(void);
+uint16_t *soft_gpu_vram(void);
+void soft_gpu_load_image(const RECT *rect, const uint32_t *data);
+
+// Applies the environment (including the isbg clear) and then rasterizes the
+// packet chain starting at ot, like DrawOTagEnv() does.
+void soft_gpu_draw_ot(const uint32_t *ot, const DRAWENV *env, SoftGpuStats *stats);
+
+// The same in two steps, for packets that are not in a linked chain (trace
+// replay): apply the environment, then run packets (words after the tag).
+void soft_gpu_begin(const DRAWENV *env, SoftGpuStats *stats);
+void soft_gpu_execute(const uint32_t *words, int length);
+
+// Number of words taken by the GP0 command at words[0], 0 if unknown
+int soft_gpu_command_length(const uint32_t *words, int available);
+
+// Converts a VRAM rectangle to 8-bit RGB and back, rgb holds w * h * 3 bytes.
+// Mask bits are lost in the conversion.
+void soft_gpu_read_rgb(int x, int y, int w, int h, uint8_t *rgb);
+void soft_gpu_write_rgb(int x, int y, int w, int h, const uint8_t *rgb);
+
+#endif // SOFT_GPU_H
@@ -0,0 +1,166 @@
+/**
+ * @file input_latency.c
+ * @brief Input to photon latency measurement
+ *
+ * While a measurement runs, every input change synced by sync_all_pads() or
+ * sync_pad() is stamped with the vblank count and root counter 1 value of
+ * the driver poll that saw it (the capture snapshot, or the sync itself
+ * without capture). The earliest change not shown yet rides along with the
+ * next frame flip_buffers() finishes, as that is the first frame whose game
+ * state has seen it, and when that frame's OT goes to the GPU the time since
+ * the poll is added to the statistics: a histogram in frames (vblanks
+ * crossed) and the min/average/max in microseconds.
+ *
+ * The end point is DrawOTagEnv(), the frame reaches the screen at the first
+ * vblank after the GPU is done with it. The start point is the poll, a press
+ * can be up to one poll period older than that.
+ *
+ * The OT can be started from the DrawSync interrupt with the render
+ * pipeline, so the statistics are only updated there and read in a critical
+ * section.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "input_latency.h"
+#include "platform.h"
+#include "profiler.h"
+#include "render_context.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+   uint32_t vblank;
+   uint16_t hblank;
+   bool valid;
+} InputStamp;
+
+static bool active = false;
+static InputStamp pending;
+static InputStamp buffer_stamps[MAX_RENDER_BUFFERS];
+static InputLatencyStats stats;
+
+void input_latency_start(void)
+{
+   platform_enter_critical();
+   memset(&stats, 0, sizeof(stats));
+   memset(buffer_stamps, 0, sizeof(buffer_stamps));
+   pending.valid = false;
+   stats.min_ticks = 0xffff;
+   active = true;
+   platform_exit_critical();
+}
+
+void input_latency_stop(void)
+{
+   if (!active)
+   {
+      return;
+   }
+
+   active = false;
+   input_latency_print();
+}
+
+bool input_latency_is_active(void)
+{
+   return active;
+}
+
+void input_latency_handle_input(const GamePad *pad)
+{
+   if (!PAD_COMBO_PRESSED(pad, INPUT_LATENCY_COMBO))
+   {
+      return;
+   }
+
+   if (active)
+   {
+      input_latency_stop();
+   }
+   else
+   {
+      input_latency_start();
+   }
+}
+
+void input_latency_get_stats(InputLatencyStats *out)
+{
+   platform_enter_critical();
+   *out = stats;
+   platform_exit_critical();
+}
+
+void input_latency_print(void)
+{
+   InputLatencyStats copy;
+
+   input_latency_get_stats(&copy);
+   if (!copy.samples)
+   {
+      printf("latency: no input changes measured\n");
+      return;
+   }
+
+   printf("latency: %u changes, %u/%u/%u us min/avg/max, frames:", (unsigned)copy.samples,
+          (unsigned)profiler_ticks_to_us(copy.min_ticks),
+          (unsigned)profiler_ticks_to_us(copy.total_ticks / copy.samples),
+          (unsigned)profiler_ticks_to_us(copy.max_ticks));
+   for (int i = 0; i < INPUT_LATENCY_BUCKETS; i++)
+   {
+      printf(" %d%s:%u", i, i == INPUT_LATENCY_BUCKETS - 1 ? "+" : "", (unsigned)copy.frames[i]);
+   }
+   printf("\n");
+}
+
+void input_latency_sample(uint32_t vblank, uint16_t hblank)
+{
+   // Only the oldest change waiting for a frame counts
+   if (!active || pending.valid)
+   {
+      return;
+   }
+
+   pending.vblank = vblank;
+   pending.hblank = hblank;
+   pending.valid = true;
+}
+
+void input_latency_frame_queued(int buffer)
+{
+   if (!active)
+   {
+      return;
+   }
+
+   buffer_stamps[buffer] = pending;
+   pending.valid = false;
+}
+
+void input_latency_frame_drawn(int buffer)
+{
+   InputStamp *stamp = &buffer_stamps[buffer];
+
+   if (!active || !stamp->valid)
+   {
+      return;
+   }
+
+   // The hblank difference wraps after about 4 seconds
+   uint32_t frames = platform_vblank_count() - stamp->vblank;
+   uint16_t ticks = (uint16_t)(platform_hblank_ticks() - stamp->hblank);
+
+   stamp->valid = false;
+   stats.samples++;
+   stats.frames[frames < INPUT_LATENCY_BUCKETS ? frames : INPUT_LATENCY_BUCKETS - 1]++;
+   stats.total_ticks += ticks;
+   if (ticks < stats.min_ticks)
+   {
+      stats.min_ticks = ticks;
+   }
+   if (ticks > stats.max_ticks)
+   {
+      stats.max_ticks = ticks;
+   }
+}
@@ -0,0 +1,42 @@
+#ifndef INPUT_LATENCY_H
+#define INPUT_LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "game_pad.h"
+
+// Histogram buckets in frames, the last one counts everything longer
+#define INPUT_LATENCY_BUCKETS 8
+
+// Holding both buttons starts a measurement, holding them again stops it and
+// prints the report
+#define INPUT_LATENCY_COMBO (PAD_BUTTON_SELECT | PAD_BUTTON_R2)
+
+// Latencies from the poll that saw an input change to the start of drawing
+// the first frame built after it. Ticks are hblanks (root counter 1).
+typedef struct
+{
+   uint32_t samples;
+   uint32_t frames[INPUT_LATENCY_BUCKETS];
+   uint32_t total_ticks;
+   uint16_t min_ticks;
+   uint16_t max_ticks;
+} InputLatencyStats;
+
+void input_latency_start(void);
+void input_latency_stop(void);
+bool input_latency_is_active(void);
+void input_latency_handle_input(const GamePad *pad);
+void input_latency_get_stats(InputLatencyStats *stats);
+void input_latency_print(void);
+
+// Used by sync_all_pads()/sync_pad(): an input change, stamped with when the
+// driver read it
+void input_latency_sample(uint32_t vblank, uint16_t hblank);
+
+// Used by flip_buffers(): the frame in buffer was finished, then its OT was
+// handed to the GPU (possibly from the DrawSync interrupt)
+void input_latency_frame_queued(int buffer);
+void input_latency_frame_drawn(int buffer);
+
+#endif // INPUT_LATENCY_H
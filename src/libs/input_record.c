@@ -0,0 +1,268 @@
+/**
+ * @file input_record.c
+ * @brief Deterministic pad input recording and playback
+ *
+ * While recording, sync_all_pads() hands every sync's samples of the
+ * recorded slots to input_record_append(), which run-length encodes them in
+ * a static buffer (see input_record.h for the format): a pad that doesn't
+ * move costs nothing until it does. During playback, input_playback_next()
+ * returns the recorded samples instead of what the pads report, so a run
+ * reproduces the original one sync for sync, which is what makes a hitch or
+ * a gameplay bug repeatable and lets benchmarks run unattended.
+ *
+ * sync_pad() is left out on purpose: it syncs one pad at a time, at any
+ * point of the frame, so it has no place in a stream of whole-manager syncs.
+ * Games that want playback must read their pads through a PadManager.
+ *
+ * Recordings are saved to the memory card and sent over the serial port
+ * (a file and HOST_TRACE_FILE on the host). The game logic must only depend
+ * on synced input and tick count for playback to stay in step.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "input_record.h"
+#include "platform.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RUN_COUNT_SIZE 2
+#define MAX_RUN_COUNT 0xffff
+
+typedef enum
+{
+   INPUT_IDLE,
+   INPUT_RECORDING,
+   INPUT_PLAYING
+} InputRecordMode;
+
+static uint32_t stream[INPUT_RECORD_CAPACITY / 4];
+static InputRecordMode mode = INPUT_IDLE;
+
+static uint32_t syncs_left = 0;
+
+// Offset in bytes of the current run while recording or playing, 0 before
+// the first one
+static size_t run_offset = 0;
+static uint16_t run_left = 0;
+
+static InputRecordHeader *stream_header(void)
+{
+   return (InputRecordHeader *)stream;
+}
+
+static uint8_t *stream_bytes(void)
+{
+   return (uint8_t *)stream;
+}
+
+static int count_slots(uint32_t slot_mask)
+{
+   int count = 0;
+
+   for (int slot = 0; slot < MAX_GAME_PADS; slot++)
+   {
+      count += (slot_mask >> slot) & 1;
+   }
+
+   return count;
+}
+
+static size_t run_size(uint32_t slot_mask)
+{
+   return RUN_COUNT_SIZE + count_slots(slot_mask) * sizeof(InputSample);
+}
+
+static uint16_t read_run_count(size_t offset)
+{
+   uint16_t count;
+
+   memcpy(&count, &stream_bytes()[offset], sizeof(count));
+   return count;
+}
+
+static void write_run_count(size_t offset, uint16_t count)
+{
+   memcpy(&stream_bytes()[offset], &count, sizeof(count));
+}
+
+void input_record_start(uint8_t slot_mask, uint32_t syncs)
+{
+   InputRecordHeader *header = stream_header();
+
+   header->magic = INPUT_RECORD_MAGIC;
+   header->slot_mask = slot_mask;
+   header->entries = 0;
+   header->size = sizeof(InputRecordHeader);
+
+   syncs_left = syncs;
+   run_offset = 0;
+   mode = INPUT_RECORDING;
+}
+
+void input_record_stop(void)
+{
+   if (mode != INPUT_RECORDING)
+   {
+      return;
+   }
+
+   mode = INPUT_IDLE;
+
+   const InputRecordHeader *header = stream_header();
+   bool saved = platform_save_file(INPUT_RECORD_FILE, stream, header->size);
+
+   platform_trace_write(stream, header->size);
+
+   printf("input: recorded %u syncs in %u bytes%s\n", (unsigned)header->entries, (unsigned)header->size,
+          saved ? "" : ", saving failed");
+}
+
+bool input_record_is_active(void)
+{
+   return mode == INPUT_RECORDING;
+}
+
+void input_record_handle_input(const GamePad *pad)
+{
+   if (!PAD_COMBO_PRESSED(pad, INPUT_RECORD_COMBO))
+   {
+      return;
+   }
+
+   if (mode == INPUT_RECORDING)
+   {
+      input_record_stop();
+   }
+   else if (mode == INPUT_IDLE)
+   {
+      input_record_start(0xff, 0);
+   }
+}
+
+void input_record_append(const InputSample samples[MAX_GAME_PADS])
+{
+   if (mode != INPUT_RECORDING)
+   {
+      return;
+   }
+
+   InputRecordHeader *header = stream_header();
+   uint8_t *bytes = stream_bytes();
+   size_t size = run_size(header->slot_mask);
+
+   // Gather the recorded slots as they would appear in a run
+   uint8_t run[RUN_COUNT_SIZE + MAX_GAME_PADS * sizeof(InputSample)];
+   size_t length = RUN_COUNT_SIZE;
+
+   for (int slot = 0; slot < MAX_GAME_PADS; slot++)
+   {
+      if (header->slot_mask & (1 << slot))
+      {
+         memcpy(&run[length], &samples[slot], sizeof(InputSample));
+         length += sizeof(InputSample);
+      }
+   }
+
+   // Extend the current run if nothing changed
+   if (run_offset && read_run_count(run_offset) < MAX_RUN_COUNT &&
+       !memcmp(&bytes[run_offset + RUN_COUNT_SIZE], &run[RUN_COUNT_SIZE], size - RUN_COUNT_SIZE))
+   {
+      write_run_count(run_offset, read_run_count(run_offset) + 1);
+   }
+   else if (header->size + size <= INPUT_RECORD_CAPACITY)
+   {
+      run_offset = header->size;
+      memcpy(&bytes[run_offset], run, size);
+      write_run_count(run_offset, 1);
+      header->size += size;
+   }
+   else
+   {
+      // Full, keep what fits
+      input_record_stop();
+      return;
+   }
+
+   header->entries++;
+
+   if (syncs_left && --syncs_left == 0)
+   {
+      input_record_stop();
+   }
+}
+
+bool input_playback_start(const char *name)
+{
+   InputRecordHeader *header = stream_header();
+   size_t length = platform_load_file(name, stream, sizeof(stream));
+
+   if (length < sizeof(InputRecordHeader) || header->magic != INPUT_RECORD_MAGIC ||
+       header->size > length || header->slot_mask > 0xff)
+   {
+      return false;
+   }
+
+   run_offset = 0;
+   run_left = 0;
+   mode = INPUT_PLAYING;
+
+   printf("input: playing back %u syncs from %s\n", (unsigned)header->entries, name);
+   return true;
+}
+
+void input_playback_stop(void)
+{
+   if (mode == INPUT_PLAYING)
+   {
+      mode = INPUT_IDLE;
+   }
+}
+
+bool input_playback_is_active(void)
+{
+   return mode == INPUT_PLAYING;
+}
+
+bool input_playback_next(InputSample samples[MAX_GAME_PADS])
+{
+   if (mode != INPUT_PLAYING)
+   {
+      return false;
+   }
+
+   const InputRecordHeader *header = stream_header();
+   size_t size = run_size(header->slot_mask);
+
+   // Move on to the next run once this one is used up
+   if (!run_left)
+   {
+      run_offset = run_offset ? run_offset + size : sizeof(InputRecordHeader);
+      if (run_offset + size > header->size || !read_run_count(run_offset))
+      {
+         printf("input: playback finished\n");
+         mode = INPUT_IDLE;
+         return false;
+      }
+      run_left = read_run_count(run_offset);
+   }
+
+   const uint8_t *sample = &stream_bytes()[run_offset + RUN_COUNT_SIZE];
+
+   for (int slot = 0; slot < MAX_GAME_PADS; slot++)
+   {
+      if (header->slot_mask & (1 << slot))
+      {
+         memcpy(&samples[slot], sample, sizeof(InputSample));
+         sample += sizeof(InputSample);
+      }
+      else
+      {
+         memset(&samples[slot], 0, sizeof(InputSample));
+         samples[slot].stat = 0xff;
+      }
+   }
+
+   run_left--;
+   return true;
+}
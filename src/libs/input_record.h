@@ -0,0 +1,68 @@
+#ifndef INPUT_RECORD_H
+#define INPUT_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "game_pad.h"
+
+// Recording format. The stream starts with an InputRecordHeader, followed by
+// runs: a 16-bit repeat count, then one InputSample per slot in slot_mask
+// (lowest slot first). A run stands for repeat consecutive sync_all_pads()
+// calls that saw the same samples.
+#define INPUT_RECORD_MAGIC 0x31504e49 // "INP1"
+
+// One memory card block
+#define INPUT_RECORD_CAPACITY 8192
+
+// Memory card file (a file in HOST_SAVE_DIR on the host)
+#define INPUT_RECORD_FILE "BESLUS-PONGINP"
+
+// Holding both buttons starts a recording of every slot, holding them again
+// stops it and saves it
+#define INPUT_RECORD_COMBO (PAD_BUTTON_SELECT | PAD_BUTTON_L2)
+
+typedef struct
+{
+   uint32_t magic;
+   uint32_t slot_mask;
+   uint32_t entries; // sync_all_pads() calls recorded
+   uint32_t size;    // Stream bytes, header included
+} InputRecordHeader;
+
+// What one slot reported in one sync: the start of its PADTYPE (which is the
+// multitap frame layout) and the edges the game saw, so that taps captured
+// between two syncs play back too.
+typedef struct
+{
+   uint8_t stat;
+   uint8_t id;       // type << 4 | len
+   uint16_t btn;     // Active low, as sent by the pad
+   uint8_t axes[4];  // rs_x, rs_y, ls_x, ls_y
+   uint16_t pressed;
+   uint16_t released;
+} InputSample;
+
+// Records the slots in the mask until stopped or the stream is full; syncs
+// is the number of syncs to record before stopping, 0 for no limit.
+void input_record_start(uint8_t slot_mask, uint32_t syncs);
+
+// Stops recording, saves the stream to the memory card and sends it over the
+// serial port (see platform_trace_write()).
+void input_record_stop(void);
+bool input_record_is_active(void);
+void input_record_handle_input(const GamePad *pad);
+
+// Loads a recording from the memory card and feeds it to sync_all_pads()
+// instead of the pads until it runs out. Only sync_all_pads() is recorded
+// and played back: sync_pad() always reads the pads.
+bool input_playback_start(const char *name);
+void input_playback_stop(void);
+bool input_playback_is_active(void);
+
+// Used by sync_all_pads(): the next samples to play (false when playback
+// isn't running), and the samples to record.
+bool input_playback_next(InputSample samples[MAX_GAME_PADS]);
+void input_record_append(const InputSample samples[MAX_GAME_PADS]);
+
+#endif // INPUT_RECORD_H
@@ -0,0 +1,143 @@
+/**
+ * @file lz.c
+ * @brief Decompressor for LZ packed assets
+ *
+ * Assets are packed on the host by tools/lzpack with a byte-oriented LZ77
+ * variant close to LZ4: no entropy coding and no bit fields, so decoding is
+ * a few loads, compares and stores per sequence, which suits the R3000
+ * without a cache for data.
+ *
+ * Each sequence is:
+ * - a token: literal count in the high nibble, match length minus 4 in the
+ *   low nibble; 15 means more length bytes follow, each adding up to 255
+ * - the literal bytes
+ * - a 16-bit little endian match offset and the extra match length bytes,
+ *   omitted in the last sequence
+ *
+ * Packed files can be unpacked in place: with the packed file at the end of
+ * the output buffer, output written at the start never overwrites input that
+ * wasn't read yet, as long as the input starts at least LzHeader.margin
+ * bytes after the output. asset_loader.c relies on it to read and unpack in
+ * a single buffer that then goes straight to LoadImage().
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "lz.h"
+
+bool lz_is_packed(const void *data)
+{
+   return ((const LzHeader *)data)->magic == LZ_MAGIC;
+}
+
+// Unpacks a whole packed file (header included). output can overlap the
+// packed data as described above. Returns false if the data is corrupt or
+// doesn't fit.
+bool lz_unpack(const void *packed, void *output, size_t capacity)
+{
+   const LzHeader *header = (const LzHeader *)packed;
+
+   if (header->magic != LZ_MAGIC || header->size > capacity)
+   {
+      return false;
+   }
+
+   // The header is overwritten first when unpacking in place
+   uint32_t size = header->size;
+   uint32_t packed_size = header->packed_size;
+
+   return lz_decode((const uint8_t *)(header + 1), packed_size, (uint8_t *)output, size) == size;
+}
+
+// Adds the extra length bytes following a token nibble of 15 to count.
+// Returns false if the input ends before the last one.
+static inline bool read_length(const uint8_t **in, const uint8_t *in_end, uint32_t *count)
+{
+   uint32_t extra;
+
+   do
+   {
+      if (*in >= in_end)
+      {
+         return false;
+      }
+      extra = *(*in)++;
+      *count += extra;
+   } while (extra == 255);
+
+   return true;
+}
+
+// Decodes raw sequences and returns the number of bytes written, or 0 on
+// corrupt or truncated input: every input byte is checked against the end
+// before it is read. Bounds are checked once per run rather than per byte, and
+// the copy loops only keep the two pointers and an end pointer live: a load,
+// a store and two increments per byte on the R3000. Copying words instead
+// would need lwl/lwr pairs for the unaligned cases and only pays off on runs
+// longer than what TIM data usually has.
+size_t lz_decode(const uint8_t *input, size_t length, uint8_t *output, size_t capacity)
+{
+   const uint8_t *in = input;
+   const uint8_t *in_end = input + length;
+   uint8_t *out = output;
+   uint8_t *out_end = output + capacity;
+
+   while (in < in_end)
+   {
+      uint32_t token = *in++;
+      uint32_t count = token >> 4;
+
+      // Literals
+      if (count == 15 && !read_length(&in, in_end, &count))
+      {
+         return 0;
+      }
+
+      if (count > (size_t)(in_end - in) || count > (size_t)(out_end - out))
+      {
+         return 0;
+      }
+
+      const uint8_t *literal_end = in + count;
+      while (in < literal_end)
+      {
+         *out++ = *in++;
+      }
+
+      // The last sequence has no match
+      if (in >= in_end)
+      {
+         break;
+      }
+
+      // Match
+      if (in_end - in < 2)
+      {
+         return 0;
+      }
+      uint32_t offset = in[0] | (in[1] << 8);
+      in += 2;
+
+      count = (token & 15) + LZ_MIN_MATCH;
+      if ((token & 15) == 15 && !read_length(&in, in_end, &count))
+      {
+         return 0;
+      }
+
+      if (!offset || offset > (size_t)(out - output) || count > (size_t)(out_end - out))
+      {
+         return 0;
+      }
+
+      // Overlapping copies (offset < count) repeat the last bytes, which a
+      // forward byte copy does naturally.
+      const uint8_t *match = out - offset;
+      uint8_t *match_end = out + count;
+      while (out < match_end)
+      {
+         *out++ = *match++;
+      }
+   }
+
+   return (size_t)(out - output);
+}
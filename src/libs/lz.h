@@ -0,0 +1,28 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// "LZP1", little endian
+#define LZ_MAGIC 0x31505a4c
+
+// Matches are at least this long, the window is 64 KB
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+
+// Header of a packed file, followed by packed_size bytes of LZ sequences
+typedef struct
+{
+   uint32_t magic;
+   uint32_t size;        // Unpacked size
+   uint32_t packed_size; // Sequence bytes after the header
+   uint32_t margin;      // How far the output may run ahead of the input, see lz.c
+} LzHeader;
+
+bool lz_is_packed(const void *data);
+bool lz_unpack(const void *packed, void *output, size_t capacity);
+size_t lz_decode(const uint8_t *input, size_t length, uint8_t *output, size_t capacity);
+
+#endif // LZ_H
@@ -0,0 +1,163 @@
+/**
+ * @file ot_layer.c
+ * @brief Named draw layers with their own sub-OTs
+ *
+ * Each subsystem (background, playfield, HUD...) draws into its own layer
+ * between begin_layer() and end_layer(); every RenderContext helper
+ * (new_primitive(), draw_text(), static lists, sprite batches...) then adds
+ * to the layer's sub-OT instead of the frame OT. Layers can be built in any
+ * order and several times per frame.
+ *
+ * link_layers() splices the sub-OTs into one frame OT slot in stack order,
+ * each in O(1): a cleared sub-OT already is a chain running from its last
+ * entry to its first, so only its ends need linking. Layers that are hidden
+ * or were not built this frame are skipped.
+ *
+ * Packet arena statistics count a layer's packets towards the frame OT slot
+ * it gets linked at: the bytes drawn between begin_layer() and end_layer()
+ * are kept in frame_bytes and added to that slot by link_layers().
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "ot_layer.h"
+#include <assert.h>
+#include <string.h>
+
+// Layer drawn into since the last begin_layer()
+static OtLayer *active_layer = NULL;
+
+void init_layer(OtLayer *layer, const char *name, uint32_t *memory, int length)
+{
+   assert(length > 0 && length <= OT_LENGTH);
+
+   layer->name = name;
+   layer->memory = memory;
+   layer->length = length;
+   layer->visible = true;
+   layer->frame_number = 0;
+   layer->frame_bytes = 0;
+}
+
+// Primitives added to entry 0 of a sub-OT are drawn after the entry itself,
+// so the chain's last link would depend on what was drawn. Every sub-OT is
+// preceded by one entry that nothing draws into and that always ends it.
+static uint32_t *active_chain_end(const RenderContext *ctx, const OtLayer *layer)
+{
+   return &(layer->memory[ctx->active_buffer * (layer->length + 1)]);
+}
+
+static uint32_t *active_sub_ot(const RenderContext *ctx, const OtLayer *layer)
+{
+   return active_chain_end(ctx, layer) + 1;
+}
+
+// Credits what was drawn into the active layer to it
+static void finish_active_layer(RenderContext *ctx)
+{
+   if (active_layer)
+   {
+      active_layer->frame_bytes += ctx->arena_stats.target_bytes;
+      ctx->arena_stats.target_bytes = 0;
+      active_layer = NULL;
+   }
+}
+
+// Redirects drawing to the layer. Its sub-OT is cleared on first use in a
+// frame.
+void begin_layer(RenderContext *ctx, OtLayer *layer)
+{
+   uint32_t *ot = active_sub_ot(ctx, layer);
+
+   finish_active_layer(ctx);
+
+   if (layer->frame_number != ctx->frame_number)
+   {
+      platform_clear_ot(active_chain_end(ctx, layer), layer->length + 1);
+      layer->frame_number = ctx->frame_number;
+      layer->frame_bytes = 0;
+   }
+
+   set_draw_target(ctx, ot);
+   active_layer = layer;
+}
+
+void end_layer(RenderContext *ctx)
+{
+   finish_active_layer(ctx);
+   reset_draw_target(ctx);
+}
+
+void set_layer_visible(OtLayer *layer, bool visible)
+{
+   layer->visible = visible;
+}
+
+void init_layer_stack(LayerStack *stack)
+{
+   stack->count = 0;
+}
+
+// Adds a layer in front of the existing ones.
+void add_layer(LayerStack *stack, OtLayer *layer)
+{
+   assert(stack->count < MAX_OT_LAYERS);
+   stack->layers[stack->count++] = layer;
+}
+
+OtLayer *find_layer(const LayerStack *stack, const char *name)
+{
+   for (int i = 0; i < stack->count; i++)
+   {
+      if (!strcmp(stack->layers[i]->name, name))
+      {
+         return stack->layers[i];
+      }
+   }
+
+   return NULL;
+}
+
+// Moves a layer to a new position in drawing order, 0 being the back.
+void move_layer(LayerStack *stack, OtLayer *layer, int position)
+{
+   int index = 0;
+
+   while (index < stack->count && stack->layers[index] != layer)
+   {
+      index++;
+   }
+   assert(index < stack->count && position >= 0 && position < stack->count);
+
+   if (index < position)
+   {
+      memmove(&(stack->layers[index]), &(stack->layers[index + 1]), (position - index) * sizeof(OtLayer *));
+   }
+   else
+   {
+      memmove(&(stack->layers[position + 1]), &(stack->layers[position]), (index - position) * sizeof(OtLayer *));
+   }
+   stack->layers[position] = layer;
+}
+
+// Splices the layers built this frame into slot z of the frame OT. Chains
+// linked into a slot later are drawn earlier, so the front layer goes first.
+void link_layers(RenderContext *ctx, const LayerStack *stack, int z)
+{
+   finish_active_layer(ctx);
+   reset_draw_target(ctx);
+
+   for (int i = stack->count - 1; i >= 0; i--)
+   {
+      const OtLayer *layer = stack->layers[i];
+
+      if (!layer->visible || layer->frame_number != ctx->frame_number)
+      {
+         continue;
+      }
+
+      uint32_t *ot = active_sub_ot(ctx, layer);
+      link_packet_chain(ctx, z, &ot[layer->length - 1], active_chain_end(ctx, layer));
+      ctx->arena_stats.slot_bytes[z] += layer->frame_bytes;
+   }
+}
@@ -0,0 +1,47 @@
+#ifndef OT_LAYER_H
+#define OT_LAYER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "render_context.h"
+
+// Most layers a stack can hold
+#define MAX_OT_LAYERS 8
+
+// Number of uint32_t words a layer with a sub-OT of `length` entries needs.
+// One sub-OT is kept per render buffer, plus an entry ending its chain.
+#define OT_LAYER_WORDS(length) (((length) + 1) * MAX_RENDER_BUFFERS)
+
+// A named draw layer owning its own sub-OT. Z values used while the layer is
+// active (begin_layer()) index its sub-OT, 0 being the front. The length
+// can't exceed OT_LENGTH.
+typedef struct
+{
+   const char *name;
+   uint32_t *memory;
+   int length;
+   bool visible;
+   uint32_t frame_number; // Frame the active sub-OT was last cleared for
+   uint32_t frame_bytes;  // Packet bytes drawn into it that frame
+} OtLayer;
+
+// Layers in drawing order, back to front
+typedef struct
+{
+   OtLayer *layers[MAX_OT_LAYERS];
+   int count;
+} LayerStack;
+
+void init_layer(OtLayer *layer, const char *name, uint32_t *memory, int length);
+void begin_layer(RenderContext *ctx, OtLayer *layer);
+void end_layer(RenderContext *ctx);
+void set_layer_visible(OtLayer *layer, bool visible);
+
+void init_layer_stack(LayerStack *stack);
+void add_layer(LayerStack *stack, OtLayer *layer);
+OtLayer *find_layer(const LayerStack *stack, const char *name);
+void move_layer(LayerStack *stack, OtLayer *layer, int position);
+
+void link_layers(RenderContext *ctx, const LayerStack *stack, int z);
+
+#endif // OT_LAYER_H
@@ -0,0 +1,88 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Primitive/environment types and the packet macros (addPrim, setXY0...) come
+// from PSn00bSDK on the PS1 and from a layout-compatible copy on the host, so
+// packet generation is the same code on both.
+#ifdef PLATFORM_HOST
+#include "host/psxgpu.h"
+#include "host/psxpad.h"
+#else
+#include <psxgpu.h>
+#include <psxpad.h>
+#endif
+
+// Everything that touches the hardware or the passage of time goes through
+// these. platform_ps1.c forwards them to PSn00bSDK, host/platform_host.c runs
+// headless on a desktop machine at unbounded speed.
+
+// GPU
+void platform_init_graphics(void);
+void platform_load_font(int x, int y);
+void platform_load_image(const RECT *rect, const uint32_t *data);
+void platform_enable_display(void);
+void platform_put_display(const DISPENV *env);
+void platform_clear_ot(uint32_t *ot, int length);
+void platform_draw_ot(const uint32_t *ot, DRAWENV *env);
+void platform_draw_sync(void);
+void platform_set_draw_callback(void (*callback)(void));
+
+// Timing. Setting the vsync callback returns the one it replaces, so that
+// several modules can chain on the interrupt.
+typedef void (*PlatformCallback)(void);
+
+void platform_vsync(void);
+PlatformCallback platform_set_vsync_callback(PlatformCallback callback);
+uint32_t platform_vblank_count(void);
+uint16_t platform_hblank_ticks(void);
+bool platform_is_pal(void);
+
+// Called from busy-wait loops; lets the host simulate the interrupts the loop
+// is waiting for.
+void platform_idle(void);
+
+void platform_enter_critical(void);
+void platform_exit_critical(void);
+
+// Pads: the driver keeps both buffers updated in the PADTYPE layout. That is
+// the BIOS driver unless platform_use_sio_pad_driver() was called before
+// platform_init_pads(): sio_pad.c then polls poll_line scanlines after each
+// vblank, or only on platform_poll_pads() with PAD_POLL_ON_DEMAND.
+#define PAD_POLL_ON_DEMAND -1
+
+void platform_init_pads(uint8_t *port0, uint8_t *port1, int length);
+void platform_use_sio_pad_driver(int poll_line);
+void platform_poll_pads(void);
+
+// Called once both ports are updated. Returns false if the driver can't tell
+// (the BIOS one), vsync is the closest event then.
+bool platform_set_pad_callback(PlatformCallback callback);
+
+// CPU time the pad driver takes per frame, in microseconds, found by timing a
+// busy loop over frames vblanks with polling paused and then running.
+uint32_t platform_measure_pad_cost(int frames);
+
+// CD-ROM. Paths are ISO9660 paths like "\\ASSETS\\BALL16C.TIM;1". Reads run in
+// the background: platform_cd_read() starts one and platform_cd_read_status()
+// returns the sectors left, 0 once the data is in the buffer, or -1 on error.
+#define PLATFORM_CD_SECTOR_SIZE 2048
+
+void platform_init_cd(void);
+bool platform_cd_find_file(const char *path, uint32_t *sector, uint32_t *size);
+bool platform_cd_read(uint32_t sector, int count, uint32_t *buffer);
+int platform_cd_read_status(void);
+
+// Small files on the memory card in slot 1, a directory on the host. Names
+// are up to 20 characters. Loading returns the bytes read, 0 on failure.
+bool platform_save_file(const char *name, const void *data, size_t length);
+size_t platform_load_file(const char *name, void *buffer, size_t capacity);
+
+// Debug output for captures (gpu_trace.c): the serial port on the PS1, a file
+// on the host. Blocks until the data is sent.
+void platform_trace_write(const void *data, size_t length);
+
+#endif // PLATFORM_H
@@ -0,0 +1,379 @@
+/**
+ * @file platform_ps1.c
+ * @brief Platform layer implementation on top of PSn00bSDK
+ *
+ * Thin forwarding functions, see platform.h. The host build replaces this
+ * file with host/platform_host.c.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#ifndef PLATFORM_HOST
+
+#include "platform.h"
+#include "sio_pad.h"
+#include <psxapi.h>
+#include <hwregs_c.h>
+#include <psxsio.h>
+#include <psxcd.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_BAUD_RATE 115200
+
+// Memory cards are written in 128 byte sectors and allocated in 8 KB blocks
+#define CARD_SECTOR_SIZE 128
+#define CARD_BLOCK_SIZE 8192
+
+// BIOS file flags
+#ifndef FREAD
+#define FREAD 0x0001
+#define FWRITE 0x0002
+#define FCREATE 0x0200
+#endif
+
+void platform_init_graphics(void)
+{
+   ResetGraph(0);
+}
+
+void platform_load_font(int x, int y)
+{
+   FntLoad(x, y);
+}
+
+void platform_load_image(const RECT *rect, const uint32_t *data)
+{
+   LoadImage(rect, data);
+}
+
+void platform_enable_display(void)
+{
+   SetDispMask(1);
+}
+
+void platform_put_display(const DISPENV *env)
+{
+   PutDispEnv(env);
+}
+
+void platform_clear_ot(uint32_t *ot, int length)
+{
+   ClearOTagR(ot, length);
+}
+
+void platform_draw_ot(const uint32_t *ot, DRAWENV *env)
+{
+   DrawOTagEnv(ot, env);
+}
+
+void platform_draw_sync(void)
+{
+   DrawSync(0);
+}
+
+void platform_set_draw_callback(void (*callback)(void))
+{
+   DrawSyncCallback(callback);
+}
+
+void platform_vsync(void)
+{
+   VSync(0);
+}
+
+PlatformCallback platform_set_vsync_callback(PlatformCallback callback)
+{
+   return (PlatformCallback)VSyncCallback(callback);
+}
+
+uint32_t platform_vblank_count(void)
+{
+   return (uint32_t)VSync(-1);
+}
+
+// Root counter 1, which psxgpu keeps running off the hblank clock
+uint16_t platform_hblank_ticks(void)
+{
+   return TIMER_VALUE(1);
+}
+
+bool platform_is_pal(void)
+{
+   return GetVideoMode() == MODE_PAL;
+}
+
+void platform_idle(void)
+{
+}
+
+void platform_enter_critical(void)
+{
+   EnterCriticalSection();
+}
+
+void platform_exit_critical(void)
+{
+   ExitCriticalSection();
+}
+
+static bool use_sio_pads = false;
+static int sio_poll_line = 0;
+
+void platform_init_pads(uint8_t *port0, uint8_t *port1, int length)
+{
+   if (use_sio_pads)
+   {
+      sio_pad_init(port0, port1, length, sio_poll_line);
+      return;
+   }
+
+   InitPAD((char *)port0, length, (char *)port1, length);
+   StartPAD();
+   ChangeClearPAD(1);
+}
+
+void platform_use_sio_pad_driver(int poll_line)
+{
+   use_sio_pads = true;
+   sio_poll_line = poll_line;
+   sio_pad_set_poll_line(poll_line);
+}
+
+void platform_poll_pads(void)
+{
+   if (use_sio_pads)
+   {
+      sio_pad_poll();
+   }
+}
+
+bool platform_set_pad_callback(PlatformCallback callback)
+{
+   if (!use_sio_pads)
+   {
+      return false;
+   }
+
+   sio_pad_set_callback(callback);
+   return true;
+}
+
+static uint32_t count_idle_loops(int frames)
+{
+   volatile uint32_t count = 0;
+
+   VSync(0);
+   uint32_t end = (uint32_t)VSync(-1) + frames;
+   while ((uint32_t)VSync(-1) < end)
+   {
+      count++;
+   }
+
+   return count;
+}
+
+static void set_pad_polling(bool enabled)
+{
+   if (use_sio_pads)
+   {
+      sio_pad_set_enabled(enabled);
+   }
+   else if (enabled)
+   {
+      StartPAD();
+   }
+   else
+   {
+      StopPAD();
+   }
+}
+
+uint32_t platform_measure_pad_cost(int frames)
+{
+   set_pad_polling(false);
+   uint32_t idle = count_idle_loops(frames);
+   set_pad_polling(true);
+   uint32_t polling = count_idle_loops(frames);
+
+   if (!idle || polling >= idle)
+   {
+      return 0;
+   }
+
+   uint32_t frame_us = platform_is_pal() ? 20000 : 16683;
+   return (uint32_t)((uint64_t)(idle - polling) * frame_us / idle);
+}
+
+void platform_init_cd(void)
+{
+   CdInit();
+}
+
+// CdSearchFile() blocks while it reads the directory, PSn00bSDK caches the
+// last directory read.
+bool platform_cd_find_file(const char *path, uint32_t *sector, uint32_t *size)
+{
+   CdlFILE file;
+
+   if (!CdSearchFile(&file, path))
+   {
+      return false;
+   }
+
+   *sector = (uint32_t)CdPosToInt(&(file.pos));
+   *size = file.size;
+   return true;
+}
+
+bool platform_cd_read(uint32_t sector, int count, uint32_t *buffer)
+{
+   CdlLOC location;
+
+   CdIntToPos((int)sector, &location);
+   CdControl(CdlSetloc, (const uint8_t *)&location, NULL);
+   return CdRead(count, buffer, CdlModeSpeed) != 0;
+}
+
+int platform_cd_read_status(void)
+{
+   return CdReadSync(1, NULL);
+}
+
+// The card driver shares SIO0 with the pad driver. With the BIOS pad driver,
+// InitCARD(1) keeps pads polled and the card driver can stay started. The
+// SIO pad driver is suspended for each access instead, and the card driver
+// stopped afterwards so that it leaves SIO0 alone.
+static void begin_card_access(void)
+{
+   static bool card_ready = false;
+
+   if (use_sio_pads)
+   {
+      sio_pad_suspend();
+   }
+
+   if (!card_ready)
+   {
+      InitCARD(use_sio_pads ? 0 : 1);
+      StartCARD();
+      _bu_init();
+      card_ready = true;
+   }
+   else if (use_sio_pads)
+   {
+      StartCARD();
+   }
+}
+
+static void end_card_access(void)
+{
+   if (use_sio_pads)
+   {
+      StopCARD();
+      sio_pad_resume();
+   }
+}
+
+static bool write_card_file(const char *name, const void *data, size_t length)
+{
+   const uint8_t *bytes = (const uint8_t *)data;
+   uint8_t sector[CARD_SECTOR_SIZE];
+   char path[32];
+   int blocks = (int)((length + CARD_BLOCK_SIZE - 1) / CARD_BLOCK_SIZE);
+
+   snprintf(path, sizeof(path), "bu00:%s", name);
+
+   // Files can't be resized, recreate it
+   erase(path);
+   int fd = open(path, FCREATE | (blocks << 16));
+   if (fd < 0)
+   {
+      return false;
+   }
+   close(fd);
+
+   fd = open(path, FWRITE);
+   if (fd < 0)
+   {
+      return false;
+   }
+
+   bool ok = true;
+   for (size_t offset = 0; ok && offset < length; offset += CARD_SECTOR_SIZE)
+   {
+      size_t chunk = length - offset < CARD_SECTOR_SIZE ? length - offset : CARD_SECTOR_SIZE;
+
+      memset(sector, 0, sizeof(sector));
+      memcpy(sector, &bytes[offset], chunk);
+      ok = write(fd, sector, CARD_SECTOR_SIZE) == CARD_SECTOR_SIZE;
+   }
+
+   close(fd);
+   return ok;
+}
+
+static size_t read_card_file(const char *name, void *buffer, size_t capacity)
+{
+   uint8_t *bytes = (uint8_t *)buffer;
+   uint8_t sector[CARD_SECTOR_SIZE];
+   char path[32];
+   size_t length = 0;
+
+   snprintf(path, sizeof(path), "bu00:%s", name);
+
+   int fd = open(path, FREAD);
+   if (fd < 0)
+   {
+      return 0;
+   }
+
+   // Reads come in whole sectors, the caller's header tells the real size
+   while (length < capacity && read(fd, sector, CARD_SECTOR_SIZE) == CARD_SECTOR_SIZE)
+   {
+      size_t chunk = capacity - length < CARD_SECTOR_SIZE ? capacity - length : CARD_SECTOR_SIZE;
+
+      memcpy(&bytes[length], sector, chunk);
+      length += chunk;
+   }
+
+   close(fd);
+   return length;
+}
+
+bool platform_save_file(const char *name, const void *data, size_t length)
+{
+   begin_card_access();
+   bool ok = write_card_file(name, data, length);
+   end_card_access();
+
+   return ok;
+}
+
+size_t platform_load_file(const char *name, void *buffer, size_t capacity)
+{
+   begin_card_access();
+   size_t length = read_card_file(name, buffer, capacity);
+   end_card_access();
+
+   return length;
+}
+
+void platform_trace_write(const void *data, size_t length)
+{
+   static bool sio_ready = false;
+   const uint8_t *bytes = (const uint8_t *)data;
+
+   if (!sio_ready)
+   {
+      SIO_Init(TRACE_BAUD_RATE, SIO_MR_BR_16 | SIO_MR_CHLEN_8 | SIO_MR_SB_01);
+      sio_ready = true;
+   }
+
+   for (size_t i = 0; i < length; i++)
+   {
+      SIO_WriteByte2(bytes[i]);
+   }
+}
+
+#endif // PLATFORM_HOST
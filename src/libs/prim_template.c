@@ -0,0 +1,43 @@
+/**
+ * @file prim_template.c
+ * @brief Primitives copied from pre-initialized templates
+ *
+ * Most primitives drawn every frame only differ in their position: code,
+ * size and color are rewritten with the same values over and over, one
+ * field store at a time. A template is a primitive set up once (ideally at
+ * compile time, see the *_TEMPLATE() initializers), and per-frame code copies
+ * it with a few word stores and patches only the fields that change.
+ *
+ * Usage:
+ *    static const TILE paddle = TILE_TEMPLATE(8, 32, 255, 255, 255);
+ *    TILE *tile = (TILE *)new_primitive_from(ctx, z, &paddle, sizeof(TILE));
+ *    setXY0(tile, x, y);
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "prim_template.h"
+
+// Copies a template over a primitive that is already linked into an OT or
+// list: the length is taken from the template and the link is kept.
+void apply_template(void *prim, const void *template, size_t size)
+{
+   uint32_t *dst = (uint32_t *)prim;
+   const uint32_t *src = (const uint32_t *)template;
+   size_t words = size / 4;
+
+   dst[0] = (dst[0] & 0xffffff) | (src[0] & 0xff000000);
+   for (size_t i = 1; i < words; i++)
+   {
+      dst[i] = src[i];
+   }
+}
+
+// new_primitive() initialized from a template
+void *new_primitive_from(RenderContext *ctx, int z, const void *template, size_t size)
+{
+   void *prim = new_primitive(ctx, z, size);
+
+   apply_template(prim, template, size);
+   return prim;
+}
@@ -0,0 +1,25 @@
+#ifndef PRIM_TEMPLATE_H
+#define PRIM_TEMPLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "render_context.h"
+
+// Compile-time initializers for fully set up primitives. The link part of the
+// tag is filled in when the copy is inserted into an OT, so only the length
+// is set here. Declare templates `static const` so they end up in .rodata.
+#define PRIM_TEMPLATE_TAG(words) ((uint32_t)(words) << 24)
+
+// Untextured rectangle, like setTile() + setWH() + setRGB0()
+#define TILE_TEMPLATE(_w, _h, _r, _g, _b) \
+   {.tag = PRIM_TEMPLATE_TAG(3), .r0 = (_r), .g0 = (_g), .b0 = (_b), .code = 0x60, .w = (_w), .h = (_h)}
+
+// Textured rectangle with neutral tint, like setSprt() + setUV0() + setWH()
+#define SPRT_TEMPLATE(_u, _v, _clut, _w, _h)                                       \
+   {.tag = PRIM_TEMPLATE_TAG(4), .r0 = 128, .g0 = 128, .b0 = 128, .code = 0x64, \
+    .u0 = (_u), .v0 = (_v), .clut = (_clut), .w = (_w), .h = (_h)}
+
+void apply_template(void *prim, const void *template, size_t size);
+void *new_primitive_from(RenderContext *ctx, int z, const void *template, size_t size);
+
+#endif // PRIM_TEMPLATE_H
@@ -0,0 +1,202 @@
+/**
+ * @file profiler.c
+ * @brief Per-frame timing based on the PS1 root counters
+ *
+ * Splits each frame into update, packet build, DrawSync and VSync time using
+ * root counter 1, which psxgpu keeps running off the hblank clock (one tick
+ * per scanline, ~63.6us NTSC / 64us PAL). Reading it is a single uncached
+ * load, so the marks are cheap enough to stay in release builds.
+ *
+ * The last PROFILER_HISTORY frames are kept in a ring buffer and can be drawn
+ * as stacked bars with the averages printed next to them:
+ *
+ *   update (green) | build (blue) | drawsync (red) | vsync (grey)
+ *
+ * The horizontal line marks one full frame at the current video mode.
+ *
+ * Usage:
+ * 1. profiler_begin_frame() at the top of the main loop
+ * 2. profiler_mark(PROFILE_UPDATE) / profiler_mark(PROFILE_BUILD) at the end
+ *    of each part; flip_buffers() marks the DrawSync and VSync waits itself
+ * 3. profiler_end_frame() after flip_buffers()
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "profiler.h"
+#include "format.h"
+#include <string.h>
+
+// Scanlines per frame, used for the budget line
+#define NTSC_FRAME_TICKS 263
+#define PAL_FRAME_TICKS 314
+
+// Bar graph layout
+#define BAR_WIDTH 2
+#define TICKS_PER_PIXEL 4
+
+static ProfilerFrame history[PROFILER_HISTORY];
+static ProfilerFrame current_frame;
+static int history_head = 0;
+static uint16_t last_mark = 0;
+static bool hud_visible = false;
+
+static const uint8_t section_colors[PROFILE_SECTION_COUNT][3] = {
+    {0, 192, 0},
+    {64, 96, 255},
+    {255, 48, 48},
+    {96, 96, 96}};
+
+static const char *const section_names[PROFILE_SECTION_COUNT] = {
+    "UPD", "BLD", "DS", "VS"};
+
+static inline uint16_t read_counter(void)
+{
+   return platform_hblank_ticks();
+}
+
+void profiler_init(void)
+{
+   memset(history, 0, sizeof(history));
+   memset(&current_frame, 0, sizeof(current_frame));
+   history_head = 0;
+   hud_visible = false;
+   last_mark = read_counter();
+}
+
+void profiler_begin_frame(void)
+{
+   memset(&current_frame, 0, sizeof(current_frame));
+   last_mark = read_counter();
+}
+
+void profiler_mark(ProfilerSection section)
+{
+   uint16_t now = read_counter();
+
+   // The counter is 16 bits wide, unsigned subtraction handles the wrap.
+   current_frame.ticks[section] += (uint16_t)(now - last_mark);
+   last_mark = now;
+}
+
+void profiler_end_frame(void)
+{
+   current_frame.total = 0;
+   for (int i = 0; i < PROFILE_SECTION_COUNT; i++)
+   {
+      current_frame.total += current_frame.ticks[i];
+   }
+
+   history[history_head] = current_frame;
+   history_head = (history_head + 1) % PROFILER_HISTORY;
+}
+
+// Returns a recorded frame, 0 being the most recent one.
+const ProfilerFrame *profiler_get_frame(int frames_ago)
+{
+   int index = (history_head - 1 - frames_ago) % PROFILER_HISTORY;
+
+   if (index < 0)
+   {
+      index += PROFILER_HISTORY;
+   }
+
+   return &history[index];
+}
+
+uint32_t profiler_ticks_to_us(uint32_t ticks)
+{
+   // 1 / 15734 Hz (NTSC) and 1 / 15625 Hz (PAL)
+   if (platform_is_pal())
+   {
+      return ticks * 64;
+   }
+
+   return (ticks * 6356) / 100;
+}
+
+void profiler_handle_input(const GamePad *pad)
+{
+   if (PAD_COMBO_PRESSED(pad, PROFILER_TOGGLE_COMBO))
+   {
+      hud_visible = !hud_visible;
+   }
+}
+
+bool profiler_is_visible(void)
+{
+   return hud_visible;
+}
+
+static void draw_rect(RenderContext *ctx, int x, int y, int w, int h, const uint8_t *color)
+{
+   // The HUD must never push game primitives out of the packet buffer.
+   TILE *tile = (TILE *)try_new_primitive(ctx, 0, sizeof(TILE));
+   if (!tile)
+   {
+      return;
+   }
+
+   setTile(tile);
+   setXY0(tile, x, y);
+   setWH(tile, w, h);
+   setRGB0(tile, color[0], color[1], color[2]);
+}
+
+// Draws the history as stacked bars growing upwards from (x, y), oldest frame
+// on the left, followed by the average of each section in microseconds.
+void profiler_draw(RenderContext *ctx, int x, int y)
+{
+   static const uint8_t budget_color[3] = {255, 255, 255};
+   uint32_t sums[PROFILE_SECTION_COUNT] = {0};
+   int frame_ticks = (platform_is_pal()) ? PAL_FRAME_TICKS : NTSC_FRAME_TICKS;
+   int text_x = x + PROFILER_HISTORY * BAR_WIDTH + 8;
+   int top = y - frame_ticks / TICKS_PER_PIXEL;
+   int right = text_x;
+
+   draw_rect(ctx, x, top, PROFILER_HISTORY * BAR_WIDTH, 1, budget_color);
+
+   for (int i = 0; i < PROFILER_HISTORY; i++)
+   {
+      const ProfilerFrame *frame = profiler_get_frame(PROFILER_HISTORY - 1 - i);
+      int bar_x = x + i * BAR_WIDTH;
+      int bar_y = y;
+
+      for (int s = 0; s < PROFILE_SECTION_COUNT; s++)
+      {
+         int h = frame->ticks[s] / TICKS_PER_PIXEL;
+
+         sums[s] += frame->ticks[s];
+         if (h > 0)
+         {
+            bar_y -= h;
+            draw_rect(ctx, bar_x, bar_y, BAR_WIDTH, h, section_colors[s]);
+         }
+      }
+      if (bar_y < top)
+      {
+         top = bar_y;
+      }
+   }
+
+   char text_buffer[4 + FORMAT_BUFFER_SIZE];
+   for (int s = 0; s < PROFILE_SECTION_COUNT; s++)
+   {
+      int length = strlen(section_names[s]);
+
+      memcpy(text_buffer, section_names[s], length);
+      text_buffer[length] = ' ';
+      length += 1 + format_uint(&text_buffer[length + 1], profiler_ticks_to_us(sums[s] / PROFILER_HISTORY));
+      draw_text(ctx, text_x, y - 8 * (PROFILE_SECTION_COUNT - s), 0, text_buffer);
+      if (text_x + 8 * length > right)
+      {
+         right = text_x + 8 * length;
+      }
+   }
+
+   if (y - 8 * PROFILE_SECTION_COUNT < top)
+   {
+      top = y - 8 * PROFILE_SECTION_COUNT;
+   }
+   mark_dirty(ctx, x, top, right - x, y - top);
+}
@@ -0,0 +1,46 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "game_pad.h"
+#include "render_context.h"
+
+// Number of frames kept in the history ring buffer (and drawn as bars)
+#define PROFILER_HISTORY 32
+
+// Holding both buttons toggles the HUD
+#define PROFILER_TOGGLE_COMBO (PAD_BUTTON_SELECT | PAD_BUTTON_R1)
+
+// Parts of a frame the profiler tells apart. Time is attributed to a section
+// when profiler_mark() is called at its end.
+typedef enum {
+   PROFILE_UPDATE,   // Input and game logic
+   PROFILE_BUILD,    // Filling the OT and packet buffer
+   PROFILE_DRAWSYNC, // Blocked waiting for the GPU
+   PROFILE_VSYNC,    // Blocked waiting for vblank
+   PROFILE_SECTION_COUNT
+} ProfilerSection;
+
+// Durations are in hblanks (root counter 1 ticks), about 64us each
+typedef struct {
+   uint16_t ticks[PROFILE_SECTION_COUNT];
+   uint16_t total;
+} ProfilerFrame;
+
+void profiler_init(void);
+void profiler_begin_frame(void);
+void profiler_mark(ProfilerSection section);
+void profiler_end_frame(void);
+
+const ProfilerFrame *profiler_get_frame(int frames_ago);
+uint32_t profiler_ticks_to_us(uint32_t ticks);
+
+void profiler_handle_input(const GamePad *pad);
+bool profiler_is_visible(void);
+
+// Draws the HUD with its baseline at y and marks the area it covers dirty
+// (see mark_dirty()), so that it is cleared once hidden
+void profiler_draw(RenderContext *ctx, int x, int y);
+
+#endif // PROFILER_H
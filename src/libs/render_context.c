@@ -0,0 +1,632 @@
+/**
+ * @file render_context.c
+ * @brief Double/triple buffered display list management
+ *
+ * A RenderContext owns the framebuffers, ordering tables and packet buffers
+ * the game draws into. Two modes are available:
+ *
+ * - Regular mode (default): flip_buffers() waits for the GPU and for vblank,
+ *   then starts drawing the frame that was just built.
+ * - Pipelined mode (enable_render_pipeline()): flip_buffers() only queues the
+ *   finished frame. A DrawSync callback kicks queued frames as soon as the GPU
+ *   goes idle and a VSync callback puts drawn frames on screen, so the CPU can
+ *   build frame N+1 while the GPU is still busy with frame N. With a third
+ *   buffer a frame that runs long no longer forces the next one to wait for
+ *   an extra vblank.
+ *
+ * Either mode can additionally use dirty rectangles (enable_dirty_rects()):
+ * instead of having the GPU clear the whole framebuffer every frame, only the
+ * areas the game marked with mark_dirty() the last time a buffer was drawn
+ * get cleared with FILL packets. Everything in the OT is still drawn every
+ * frame, so only content that moves or changes has to be marked; the whole
+ * screen is cleared when the marked area gets past a threshold or after
+ * invalidate_screen().
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "render_context.h"
+#include "profiler.h"
+#include "gpu_trace.h"
+#include "input_latency.h"
+#include <assert.h>
+#include <string.h>
+
+// The DrawSync/VSync callbacks take no arguments, so the pipelined context is
+// kept here.
+static RenderContext *pipeline_ctx = NULL;
+
+// Primitives that could not be allocated at all are written here instead, so
+// callers of new_primitive() never have to check for NULL. Large enough for
+// the biggest GPU primitive (POLY_GT4).
+static uint32_t discarded_packet[16];
+
+// Fold the counters of the frame that was just completed into the last/peak
+// counters and start counting from zero.
+static void finish_frame_stats(PacketArenaStats *stats)
+{
+   stats->last_bytes = stats->frame_bytes;
+   stats->last_spilled_bytes = stats->frame_spilled_bytes;
+   stats->last_dropped = stats->frame_dropped;
+
+   if (stats->frame_bytes > stats->peak_bytes)
+   {
+      stats->peak_bytes = stats->frame_bytes;
+   }
+   for (int i = 0; i < OT_LENGTH; i++)
+   {
+      if (stats->slot_bytes[i] > stats->peak_slot_bytes[i])
+      {
+         stats->peak_slot_bytes[i] = stats->slot_bytes[i];
+      }
+      stats->slot_bytes[i] = 0;
+   }
+   if (stats->frame_spilled_bytes)
+   {
+      stats->total_spilled_frames++;
+   }
+
+   stats->frame_bytes = 0;
+   stats->frame_spilled_bytes = 0;
+   stats->frame_dropped = 0;
+   stats->target_bytes = 0;
+}
+
+// Make a buffer the CPU's active one: reset the packet allocation pointer and
+// clear its OT.
+static void begin_frame(RenderContext *ctx, int index)
+{
+   RenderBuffer *buffer = &(ctx->buffers[index]);
+
+   ctx->active_buffer = index;
+   ctx->next_packet = buffer->buffer;
+   ctx->packet_end = &(buffer->buffer[ctx->config.buffer_length]);
+   ctx->target_ot = buffer->ot;
+   ctx->frame_number++;
+   buffer->frame_number = ctx->frame_number;
+   platform_clear_ot(buffer->ot, ctx->config.ot_length);
+}
+
+// Set up a context using caller-provided memory, sized with
+// RENDER_MEMORY_WORDS() for the same config. The memory can live anywhere
+// (static RAM, a per game mode pool...) as long as it outlives the context. A
+// context can be initialized again with a different config, e.g. when
+// switching game modes, once the GPU is done with it.
+void initialize_render_context(RenderContext *ctx, const RenderConfig *config, uint32_t *memory,
+                               int w, int h, int r, int g, int b)
+{
+   assert(config->ot_length > 0 && config->ot_length <= OT_LENGTH);
+   assert(config->buffer_count >= 2 && config->buffer_count <= MAX_RENDER_BUFFERS);
+   assert(!(config->buffer_length & 3) && !(config->spill_length & 3));
+
+   ctx->config = *config;
+
+   // Carve the OTs and packet buffers out of the provided memory.
+   uint32_t *packets = &memory[config->ot_length * config->buffer_count];
+   size_t packet_words = (config->buffer_length + config->spill_length) / 4;
+
+   for (int i = 0; i < config->buffer_count; i++)
+   {
+      RenderBuffer *buffer = &(ctx->buffers[i]);
+
+      buffer->ot = &memory[i * config->ot_length];
+      buffer->buffer = (uint8_t *)&packets[i * packet_words];
+      buffer->spill = &(buffer->buffer[config->buffer_length]);
+   }
+
+   // Place the two framebuffers vertically in VRAM.
+   SetDefDrawEnv(&(ctx->buffers[0].draw_env), 0, 0, w, h);
+   SetDefDispEnv(&(ctx->buffers[0].disp_env), 0, 0, w, h);
+   SetDefDrawEnv(&(ctx->buffers[1].draw_env), 0, h, w, h);
+   SetDefDispEnv(&(ctx->buffers[1].disp_env), 0, h, w, h);
+
+   // The third framebuffer, if the pipeline ever uses it, goes to the right of
+   // the first one.
+   if (config->buffer_count > 2)
+   {
+      SetDefDrawEnv(&(ctx->buffers[2].draw_env), w, 0, w, h);
+      SetDefDispEnv(&(ctx->buffers[2].disp_env), w, 0, w, h);
+   }
+
+   // Set the default background color and enable auto-clearing.
+   for (int i = 0; i < config->buffer_count; i++)
+   {
+      setRGB0(&(ctx->buffers[i].draw_env), r, g, b);
+      ctx->buffers[i].draw_env.isbg = 1;
+      ctx->buffers[i].stale_count = -1;
+   }
+
+   // Initialize the first buffer and clear its OT so that it can be used for
+   // drawing.
+   ctx->buffer_count = 2;
+   ctx->pipelined = false;
+   ctx->gpu_busy = false;
+   ctx->dirty_mode = false;
+   ctx->dirty_count = 0;
+   ctx->frame_number = 0;
+   ctx->drawn_frame = 0;
+   memset(&(ctx->arena_stats), 0, sizeof(ctx->arena_stats));
+   begin_frame(ctx, 0);
+
+   // Turn on the video output.
+   platform_enable_display();
+}
+
+// Start drawing the next frame in submission order, if it is complete. Must be
+// called with interrupts disabled or from a callback.
+static void kick_queued_buffer(RenderContext *ctx)
+{
+   RenderBuffer *buffer = &(ctx->buffers[ctx->draw_index]);
+
+   if (ctx->gpu_busy || ctx->buffer_state[ctx->draw_index] != BUFFER_QUEUED)
+   {
+      return;
+   }
+
+   ctx->buffer_state[ctx->draw_index] = BUFFER_DRAWING;
+   ctx->gpu_busy = true;
+   input_latency_frame_drawn(ctx->draw_index);
+   platform_draw_ot(&(buffer->ot[ctx->config.ot_length - 1]), &(buffer->draw_env));
+}
+
+static void pipeline_drawsync_callback(void)
+{
+   RenderContext *ctx = pipeline_ctx;
+
+   // The draw queue may also drain after a LoadImage() issued between frames,
+   // only treat this as a finished frame if one was actually being drawn.
+   if (!ctx->gpu_busy)
+   {
+      return;
+   }
+
+   ctx->buffer_state[ctx->draw_index] = BUFFER_READY;
+   ctx->drawn_frame = ctx->buffers[ctx->draw_index].frame_number;
+   ctx->draw_index = (ctx->draw_index + 1) % ctx->buffer_count;
+   ctx->gpu_busy = false;
+
+   kick_queued_buffer(ctx);
+}
+
+static void pipeline_vsync_callback(void)
+{
+   RenderContext *ctx = pipeline_ctx;
+   int next = (ctx->display_index + 1) % ctx->buffer_count;
+
+   // Frames are displayed in the order they were built. The buffer that was on
+   // screen until now can be reused by the CPU.
+   if (ctx->buffer_state[next] == BUFFER_READY)
+   {
+      platform_put_display(&(ctx->buffers[next].disp_env));
+
+      ctx->buffer_state[ctx->display_index] = BUFFER_FREE;
+      ctx->buffer_state[next] = BUFFER_DISPLAYED;
+      ctx->display_index = next;
+   }
+}
+
+void enable_render_pipeline(RenderContext *ctx, int buffer_count)
+{
+   assert(buffer_count >= 2 && buffer_count <= ctx->config.buffer_count);
+
+   // Make sure nothing from regular mode is still in flight.
+   platform_draw_sync();
+   ctx->drawn_frame = ctx->frame_number;
+
+   ctx->buffer_count = buffer_count;
+   ctx->pipelined = true;
+   ctx->gpu_busy = false;
+
+   // The CPU starts on the first buffer, the last one is treated as being on
+   // screen so that the first frame shows up as soon as it is drawn.
+   for (int i = 0; i < buffer_count; i++)
+   {
+      ctx->buffer_state[i] = BUFFER_FREE;
+   }
+
+   ctx->draw_index = 0;
+   ctx->display_index = buffer_count - 1;
+   ctx->buffer_state[0] = BUFFER_BUILDING;
+   ctx->buffer_state[buffer_count - 1] = BUFFER_DISPLAYED;
+   platform_put_display(&(ctx->buffers[buffer_count - 1].disp_env));
+   begin_frame(ctx, 0);
+
+   pipeline_ctx = ctx;
+   platform_set_draw_callback(&pipeline_drawsync_callback);
+   platform_set_vsync_callback(&pipeline_vsync_callback);
+}
+
+static void flip_buffers_pipelined(RenderContext *ctx)
+{
+   int next = (ctx->active_buffer + 1) % ctx->buffer_count;
+
+   finish_frame_stats(&(ctx->arena_stats));
+
+   // Hand the finished frame over to the GPU, it is started right away if the
+   // GPU is idle or by the DrawSync callback otherwise.
+   platform_enter_critical();
+   ctx->buffer_state[ctx->active_buffer] = BUFFER_QUEUED;
+   kick_queued_buffer(ctx);
+   platform_exit_critical();
+
+   // Buffers are released in the order they were built, so the CPU only has to
+   // wait here when every buffer is still queued, being drawn or on screen.
+   // The wait is split so the profiler can tell GPU time from vblank time.
+   while (ctx->buffer_state[next] == BUFFER_QUEUED ||
+          ctx->buffer_state[next] == BUFFER_DRAWING)
+   {
+      platform_idle();
+   }
+   profiler_mark(PROFILE_DRAWSYNC);
+
+   while (ctx->buffer_state[next] != BUFFER_FREE)
+   {
+      platform_idle();
+   }
+   profiler_mark(PROFILE_VSYNC);
+
+   ctx->buffer_state[next] = BUFFER_BUILDING;
+   begin_frame(ctx, next);
+}
+
+// Threshold is the marked area, in pixels, past which a full clear is used.
+void enable_dirty_rects(RenderContext *ctx, uint32_t threshold)
+{
+   ctx->dirty_mode = true;
+   ctx->dirty_threshold = threshold;
+   ctx->dirty_count = 0;
+   invalidate_screen(ctx);
+}
+
+void disable_dirty_rects(RenderContext *ctx)
+{
+   ctx->dirty_mode = false;
+
+   for (int i = 0; i < ctx->config.buffer_count; i++)
+   {
+      ctx->buffers[i].draw_env.isbg = 1;
+   }
+}
+
+// Marks an area, in screen coordinates, that content drawn this frame covers
+// and that will need clearing the next time this buffer is drawn.
+void mark_dirty(RenderContext *ctx, int x, int y, int w, int h)
+{
+   const RECT *clip = &(ctx->buffers[0].draw_env.clip);
+
+   if (!ctx->dirty_mode || ctx->dirty_count < 0)
+   {
+      return;
+   }
+
+   // Clip to the screen
+   if (x < 0)
+   {
+      w += x;
+      x = 0;
+   }
+   if (y < 0)
+   {
+      h += y;
+      y = 0;
+   }
+   if (x + w > clip->w)
+   {
+      w = clip->w - x;
+   }
+   if (y + h > clip->h)
+   {
+      h = clip->h - y;
+   }
+   if (w <= 0 || h <= 0)
+   {
+      return;
+   }
+
+   if (ctx->dirty_count == MAX_DIRTY_RECTS)
+   {
+      ctx->dirty_count = -1;
+      return;
+   }
+
+   setRECT(&(ctx->dirty_rects[ctx->dirty_count]), x, y, w, h);
+   ctx->dirty_count++;
+}
+
+// Forces a full clear of every buffer, for when static content changes (e.g.
+// switching screens).
+void invalidate_screen(RenderContext *ctx)
+{
+   for (int i = 0; i < ctx->config.buffer_count; i++)
+   {
+      ctx->buffers[i].stale_count = -1;
+   }
+}
+
+static uint8_t *allocate_packet(RenderContext *ctx, int z, size_t size, bool allow_spill);
+
+// Clears what the previous frame drawn in this buffer left behind. The FILLs
+// are added last to the back slot, so the GPU runs them before anything else.
+// They are allocated as one chain, and a full clear is used if it doesn't fit:
+// a dropped FILL would leave the old pixels on screen.
+static void queue_dirty_clears(RenderContext *ctx, RenderBuffer *buffer)
+{
+   DRAWENV *env = &(buffer->draw_env);
+   int z = ctx->config.ot_length - 1;
+   FILL *fills = NULL;
+   uint32_t area = 0;
+
+   for (int i = 0; i < buffer->stale_count; i++)
+   {
+      area += buffer->stale_rects[i].w * buffer->stale_rects[i].h;
+   }
+
+   env->isbg = (buffer->stale_count < 0 || area > ctx->dirty_threshold);
+
+   if (!env->isbg && buffer->stale_count > 0)
+   {
+      fills = (FILL *)allocate_packet(ctx, z, buffer->stale_count * sizeof(FILL), true);
+      env->isbg = (fills == NULL);
+   }
+
+   for (int i = 0; !env->isbg && i < buffer->stale_count; i++)
+   {
+      const RECT *rect = &(buffer->stale_rects[i]);
+      FILL *fill = &fills[i];
+
+      // FILL works in VRAM coordinates, ignoring the drawing offset, and in
+      // 16 pixel columns, so the rectangle is widened to whole columns.
+      int x0 = (env->clip.x + rect->x) & ~15;
+      int x1 = (env->clip.x + rect->x + rect->w + 15) & ~15;
+
+      setFill(fill);
+      setRGB0(fill, env->r0, env->g0, env->b0);
+      setXY0(fill, x0, env->clip.y + rect->y);
+      setWH(fill, x1 - x0, rect->h);
+      if (i + 1 < buffer->stale_count)
+      {
+         setaddr(fill, &fills[i + 1]);
+      }
+   }
+
+   if (fills && !env->isbg)
+   {
+      link_packet_chain(ctx, z, fills, &fills[buffer->stale_count - 1]);
+   }
+
+   // What this frame marked is what the buffer's next frame has to clear.
+   buffer->stale_count = ctx->dirty_count;
+   if (ctx->dirty_count > 0)
+   {
+      memcpy(buffer->stale_rects, ctx->dirty_rects, ctx->dirty_count * sizeof(RECT));
+   }
+   ctx->dirty_count = 0;
+}
+
+void flip_buffers(RenderContext *ctx)
+{
+   RenderBuffer *buffer = &(ctx->buffers[ctx->active_buffer]);
+
+   reset_draw_target(ctx);
+
+   if (ctx->dirty_mode)
+   {
+      queue_dirty_clears(ctx, buffer);
+   }
+
+   // Capture mode, a no-op unless frames were requested
+   gpu_trace_frame(buffer->ot, ctx->config.ot_length, &(buffer->draw_env));
+
+   // Latency mode, the input changes synced so far show up in this frame
+   input_latency_frame_queued(ctx->active_buffer);
+
+   if (ctx->pipelined)
+   {
+      flip_buffers_pipelined(ctx);
+      return;
+   }
+
+   finish_frame_stats(&(ctx->arena_stats));
+
+   // Wait for the GPU to finish drawing, then wait for vblank in order to
+   // prevent screen tearing.
+   platform_draw_sync();
+   ctx->drawn_frame = ctx->buffers[ctx->active_buffer ^ 1].frame_number;
+   profiler_mark(PROFILE_DRAWSYNC);
+   platform_vsync();
+   profiler_mark(PROFILE_VSYNC);
+
+   RenderBuffer *draw_buffer = &(ctx->buffers[ctx->active_buffer]);
+   RenderBuffer *disp_buffer = &(ctx->buffers[ctx->active_buffer ^ 1]);
+
+   // Display the framebuffer the GPU has just finished drawing and start
+   // rendering the display list that was filled up in the main loop.
+   platform_put_display(&(disp_buffer->disp_env));
+   input_latency_frame_drawn(ctx->active_buffer);
+   platform_draw_ot(&(draw_buffer->ot[ctx->config.ot_length - 1]), &(draw_buffer->draw_env));
+
+   // Switch over to the next buffer, clear it and reset the packet allocation
+   // pointer.
+   begin_frame(ctx, ctx->active_buffer ^ 1);
+}
+
+// Reserve space for a packet in the active buffer. Once the main packet buffer
+// is full, allocation moves on to the spill chunk if allowed. Returns NULL if
+// the packet does not fit anywhere, or if the frame has spilled and the packet
+// may not, as the spill chunk is kept for essential primitives.
+static uint8_t *allocate_packet(RenderContext *ctx, int z, size_t size, bool allow_spill)
+{
+   RenderBuffer *buffer = &(ctx->buffers[ctx->active_buffer]);
+   PacketArenaStats *stats = &(ctx->arena_stats);
+   bool spilled = (ctx->packet_end != &(buffer->buffer[ctx->config.buffer_length]));
+
+   if (spilled && !allow_spill)
+   {
+      return NULL;
+   }
+
+   if (ctx->next_packet + size > ctx->packet_end)
+   {
+      if (!allow_spill || spilled || !ctx->config.spill_length)
+      {
+         return NULL;
+      }
+
+      ctx->next_packet = buffer->spill;
+      ctx->packet_end = &(buffer->spill[ctx->config.spill_length]);
+      spilled = true;
+
+      if (ctx->next_packet + size > ctx->packet_end)
+      {
+         return NULL;
+      }
+   }
+
+   uint8_t *packet = ctx->next_packet;
+   ctx->next_packet += size;
+
+   stats->frame_bytes += size;
+   if (ctx->target_ot == buffer->ot)
+   {
+      stats->slot_bytes[z] += size;
+   }
+   else
+   {
+      stats->target_bytes += size;
+   }
+   if (spilled)
+   {
+      stats->frame_spilled_bytes += size;
+   }
+
+   return packet;
+}
+
+static void count_dropped(RenderContext *ctx)
+{
+   ctx->arena_stats.frame_dropped++;
+   ctx->arena_stats.total_dropped++;
+}
+
+void *new_primitive(RenderContext *ctx, int z, size_t size)
+{
+   // Place the primitive after all previously allocated primitives, then
+   // insert it into the OT and bump the allocation pointer.
+   uint8_t *prim = allocate_packet(ctx, z, size, true);
+
+   // Out of space even in the spill chunk: hand out a scratch packet that never
+   // gets linked into the OT rather than crashing.
+   if (!prim)
+   {
+      assert(size <= sizeof(discarded_packet));
+      count_dropped(ctx);
+      return (void *)discarded_packet;
+   }
+
+   addPrim(&(ctx->target_ot[z]), prim);
+   return (void *)prim;
+}
+
+// Low priority variant of new_primitive(): never spills and returns NULL once
+// the main packet buffer is full (even if it still has room after the frame
+// spilled), in which case the caller should skip the primitive. The drop is counted in the arena stats.
+void *try_new_primitive(RenderContext *ctx, int z, size_t size)
+{
+   uint8_t *prim = allocate_packet(ctx, z, size, false);
+
+   if (!prim)
+   {
+      count_dropped(ctx);
+      return NULL;
+   }
+
+   addPrim(&(ctx->target_ot[z]), prim);
+   return (void *)prim;
+}
+
+// A simple helper for drawing text using PSn00bSDK's debug font API. Note that
+// FntSort() requires the debug font texture to be uploaded to VRAM beforehand
+// by calling FntLoad().
+void draw_text(RenderContext *ctx, int x, int y, int z, const char *text)
+{
+   RenderBuffer *buffer = &(ctx->buffers[ctx->active_buffer]);
+
+   // FntSort() writes an unknown amount of packets, so reserve the worst case
+   // and give back what it did not use.
+   size_t reserved = FNT_SORT_SIZE(strlen(text));
+   uint8_t *packets = allocate_packet(ctx, z, reserved, true);
+
+   if (!packets)
+   {
+      count_dropped(ctx);
+      return;
+   }
+
+   uint8_t *end = (uint8_t *)FntSort(&(ctx->target_ot[z]), (char *)packets, x, y, text);
+   size_t unused = reserved - (size_t)(end - packets);
+
+   ctx->next_packet = end;
+   ctx->arena_stats.frame_bytes -= unused;
+   if (ctx->target_ot == buffer->ot)
+   {
+      ctx->arena_stats.slot_bytes[z] -= unused;
+   }
+   else
+   {
+      ctx->arena_stats.target_bytes -= unused;
+   }
+   if (ctx->packet_end != &(buffer->buffer[ctx->config.buffer_length]))
+   {
+      ctx->arena_stats.frame_spilled_bytes -= unused;
+   }
+}
+
+// Reserve room for packets the caller chains together itself (e.g. a batch of
+// sprites laid out back to back) and links with link_packet_chain(). May
+// spill; returns NULL and counts a drop if there is no room left.
+void *allocate_packets(RenderContext *ctx, int z, size_t size)
+{
+   uint8_t *packets = allocate_packet(ctx, z, size, true);
+
+   if (!packets)
+   {
+      count_dropped(ctx);
+   }
+
+   return (void *)packets;
+}
+
+// Insert a chain of packets, first to last in drawing order, into OT slot z.
+void link_packet_chain(RenderContext *ctx, int z, void *first, void *last)
+{
+   addPrims(&(ctx->target_ot[z]), first, last);
+}
+
+// Send primitives to another OT (e.g. a layer's, see ot_layer.h) until
+// reset_draw_target() is called. The OT has to stay valid for the frame.
+void set_draw_target(RenderContext *ctx, uint32_t *ot)
+{
+   ctx->target_ot = ot;
+   ctx->arena_stats.target_bytes = 0;
+}
+
+void reset_draw_target(RenderContext *ctx)
+{
+   ctx->target_ot = ctx->buffers[ctx->active_buffer].ot;
+}
+
+const PacketArenaStats *get_packet_arena_stats(const RenderContext *ctx)
+{
+   return &(ctx->arena_stats);
+}
+
+// Forget the peak counters, e.g. when switching to a different game mode.
+void reset_packet_arena_stats(RenderContext *ctx)
+{
+   PacketArenaStats *stats = &(ctx->arena_stats);
+
+   stats->peak_bytes = 0;
+   memset(stats->peak_slot_bytes, 0, sizeof(stats->peak_slot_bytes));
+   stats->total_spilled_frames = 0;
+   stats->total_dropped = 0;
+}
@@ -0,0 +1,164 @@
+#ifndef RENDER_CONTEXT_H
+#define RENDER_CONTEXT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "platform.h"
+
+// Default sizes, which can be overridden per build (e.g. -DBUFFER_LENGTH=4096)
+// or per context through RenderConfig.
+//
+// Length of the ordering table, i.e. the range Z coordinates can have, 0-15 in
+// this case. Larger values will allow for more granularity with depth (useful
+// when drawing a complex 3D scene) at the expense of RAM usage and performance.
+// This is also the longest OT a context can be configured with.
+#ifndef OT_LENGTH
+#define OT_LENGTH 16
+#endif
+
+// Size of the buffer GPU commands and primitives are written to. Use the peak
+// counters from get_packet_arena_stats() to size it for the actual scene.
+#ifndef BUFFER_LENGTH
+#define BUFFER_LENGTH 8192
+#endif
+
+// Size of the secondary packet chunk each buffer spills into once the main
+// packet buffer is full. Only essential primitives are allowed to spill, see
+// try_new_primitive(). Can be 0 to disable spilling.
+#ifndef SPILL_BUFFER_LENGTH
+#define SPILL_BUFFER_LENGTH 2048
+#endif
+
+// Worst case size of the packets FntSort() generates for a string of `len`
+// characters: one DR_TPAGE plus one SPRT_8 per character.
+#define FNT_SORT_SIZE(len) (8 + 16 * (len))
+
+// Maximum number of framebuffers a context can cycle through. Regular mode
+// always uses two, the pipelined mode can optionally use a third one.
+#define MAX_RENDER_BUFFERS 3
+
+// Rectangles the dirty rectangle mode tracks per frame, a frame marking more
+// than this gets a full clear instead.
+#define MAX_DIRTY_RECTS 16
+
+// Lifecycle of a buffer in pipelined mode
+typedef enum {
+   BUFFER_FREE,      // Can be handed to the CPU
+   BUFFER_BUILDING,  // The CPU is filling its OT and packet buffer
+   BUFFER_QUEUED,    // Complete, waiting for the GPU to become idle
+   BUFFER_DRAWING,   // The GPU is drawing its OT
+   BUFFER_READY,     // Drawn, waiting for the next vblank to be displayed
+   BUFFER_DISPLAYED  // Currently on screen
+} RenderBufferState;
+
+/* Framebuffer/display list class */
+
+typedef struct
+{
+   DISPENV disp_env;
+   DRAWENV draw_env;
+
+   // Point into the memory passed to initialize_render_context()
+   uint32_t *ot;
+   uint8_t *buffer;
+   uint8_t *spill;
+
+   // Dirty rectangle mode: areas the frame last drawn in this buffer marked
+   // dirty, to be cleared before it is drawn again. -1 requests a full clear.
+   RECT stale_rects[MAX_DIRTY_RECTS];
+   int stale_count;
+
+   uint32_t frame_number; // Frame last built in it
+} RenderBuffer;
+
+// Sizes of a context's OTs and packet buffers. The memory for them is provided
+// by the caller, see RENDER_MEMORY_WORDS().
+typedef struct
+{
+   int ot_length;        // At most OT_LENGTH
+   size_t buffer_length; // Bytes, multiple of 4
+   size_t spill_length;  // Bytes, multiple of 4
+   int buffer_count;     // 2, or 3 to allow a triple buffered pipeline
+} RenderConfig;
+
+#define DEFAULT_RENDER_CONFIG {OT_LENGTH, BUFFER_LENGTH, SPILL_BUFFER_LENGTH, MAX_RENDER_BUFFERS}
+
+// Number of uint32_t words of memory a context with the given sizes needs
+#define RENDER_MEMORY_WORDS(ot_length, buffer_length, spill_length, buffer_count) \
+   (((ot_length) + ((buffer_length) + (spill_length)) / 4) * (buffer_count))
+
+// Packet buffer usage counters. The "frame_" and "slot_" counters describe the
+// frame currently being built, "last_" the previous one and "peak_" the
+// maximum seen since the last reset_packet_arena_stats() call.
+typedef struct
+{
+   uint32_t frame_bytes;
+   uint32_t frame_spilled_bytes;
+   uint32_t frame_dropped;
+   uint32_t slot_bytes[OT_LENGTH];
+
+   // Bytes drawn since set_draw_target() into an OT other than the frame's,
+   // whose slot is only known once it gets linked (see ot_layer.c)
+   uint32_t target_bytes;
+
+   uint32_t last_bytes;
+   uint32_t last_spilled_bytes;
+   uint32_t last_dropped;
+
+   uint32_t peak_bytes;
+   uint32_t peak_slot_bytes[OT_LENGTH];
+   uint32_t total_spilled_frames;
+   uint32_t total_dropped;
+} PacketArenaStats;
+
+typedef struct
+{
+   RenderBuffer buffers[MAX_RENDER_BUFFERS];
+   uint8_t *next_packet;
+   uint8_t *packet_end;
+   uint32_t *target_ot; // OT primitives are added to, usually the active buffer's
+   int active_buffer;
+   uint32_t frame_number; // Incremented every time a frame is started
+   volatile uint32_t drawn_frame; // Last frame the GPU finished drawing
+   int buffer_count; // Buffers currently cycled through
+   RenderConfig config;
+
+   // Pipelined mode state, shared with the DrawSync/VSync callbacks
+   bool pipelined;
+   volatile bool gpu_busy;
+   volatile uint8_t buffer_state[MAX_RENDER_BUFFERS];
+   volatile int draw_index;    // Next buffer the GPU will draw
+   volatile int display_index; // Buffer currently on screen
+
+   PacketArenaStats arena_stats;
+
+   // Dirty rectangle mode state, the rectangles are the current frame's marks
+   bool dirty_mode;
+   uint32_t dirty_threshold;
+   RECT dirty_rects[MAX_DIRTY_RECTS];
+   int dirty_count; // -1 once more than MAX_DIRTY_RECTS were marked
+} RenderContext;
+
+void initialize_render_context(RenderContext *ctx, const RenderConfig *config, uint32_t *memory,
+                               int w, int h, int r, int g, int b);
+void enable_render_pipeline(RenderContext *ctx, int buffer_count);
+void flip_buffers(RenderContext *ctx);
+
+void enable_dirty_rects(RenderContext *ctx, uint32_t threshold);
+void disable_dirty_rects(RenderContext *ctx);
+void mark_dirty(RenderContext *ctx, int x, int y, int w, int h);
+void invalidate_screen(RenderContext *ctx);
+
+void *new_primitive(RenderContext *ctx, int z, size_t size);
+void *try_new_primitive(RenderContext *ctx, int z, size_t size);
+void draw_text(RenderContext *ctx, int x, int y, int z, const char *text);
+void *allocate_packets(RenderContext *ctx, int z, size_t size);
+void link_packet_chain(RenderContext *ctx, int z, void *first, void *last);
+void set_draw_target(RenderContext *ctx, uint32_t *ot);
+void reset_draw_target(RenderContext *ctx);
+
+const PacketArenaStats *get_packet_arena_stats(const RenderContext *ctx);
+void reset_packet_arena_stats(RenderContext *ctx);
+
+#endif // RENDER_CONTEXT_H
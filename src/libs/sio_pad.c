@@ -0,0 +1,399 @@
+/**
+ * @file sio_pad.c
+ * @brief Interrupt-driven controller driver on SIO0, without the BIOS
+ *
+ * The BIOS pad driver (InitPAD()/StartPAD()) polls both ports from its
+ * vblank handler, busy-waiting on every byte, at a time we don't choose.
+ * This driver runs the same exchange as a state machine on two interrupts:
+ *
+ * - Root counter 2 (system clock / 8) in one-shot mode, for the delay from
+ *   vblank to the chosen poll line, the settle time after selecting a port,
+ *   and the end of each reply: the last byte isn't acknowledged, so a reply
+ *   (or a missing pad) ends when no /ACK comes for ACK_TIMEOUT ticks.
+ * - SIO0 (IRQ 7) on /ACK: read the byte that just came in, send the next.
+ *
+ * So the CPU is only taken for a few register accesses per byte. Replies go
+ * to a staging buffer and are copied to the port buffer in PADTYPE layout
+ * (stat, id, data...) once complete, like the BIOS does, so game_pad.c reads
+ * them the same way.
+ *
+ * Exchange per port: 0x01 (address) -> -, 0x42 (read) -> id, 0x01 (tap) ->
+ * 0x5a, then 0x00 for each of the 2 * (id & 0x0f) data bytes (0 meaning 16).
+ * A tap byte of 0x01 switches a multitap to reading all four slots, from the
+ * next exchange on: it then answers with id 0x80 and 4 frames of 8 bytes,
+ * each starting with the slot's id and 0x5a (all 0xff for an empty slot).
+ * Pads ignore the tap byte. sio_pad_store_reply() turns each frame into the
+ * start of a PADTYPE (stat, id, data), the layout game_pad.c reads multitap
+ * slots in. It is shared with the host build, whose scripted multitap
+ * (HOST_MULTITAP) goes through it too.
+ *
+ * The BIOS memory card driver also talks on SIO0, from its own IRQ 7 and
+ * vblank handlers. sio_pad_suspend() waits for the running poll, then hands
+ * IRQ 7 over to it until sio_pad_resume(), which puts SIO0 back in pad mode.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "sio_pad.h"
+#include <string.h>
+
+#define PAD_REPLY_ID 0x5a
+#define MULTITAP_ID_TYPE 0x8
+#define TAP_FRAME_SIZE 8
+
+// Data bytes after the 0x5a for an id: 2 per halfword in its low nibble
+#define REPLY_DATA_LENGTH(id) (2 * ((id) & 0x0f ? (id) & 0x0f : 16))
+
+void sio_pad_store_reply(uint8_t *buffer, int length, const uint8_t *reply, int received)
+{
+   int data_length = received - 3;
+
+   if (received < 3 || reply[2] != PAD_REPLY_ID || data_length != REPLY_DATA_LENGTH(reply[1]))
+   {
+      buffer[0] = 0xff;
+      return;
+   }
+
+   if (data_length > length - 2)
+   {
+      data_length = length - 2;
+   }
+
+   buffer[0] = 0;
+   buffer[1] = reply[1];
+
+   if ((reply[1] >> 4) != MULTITAP_ID_TYPE)
+   {
+      memcpy(&buffer[2], &reply[3], data_length);
+      return;
+   }
+
+   // Tap frames: id, 0x5a, data -> stat, id, data
+   for (int offset = 0; offset + TAP_FRAME_SIZE <= data_length; offset += TAP_FRAME_SIZE)
+   {
+      const uint8_t *frame = &reply[3 + offset];
+      uint8_t *slot = &buffer[2 + offset];
+
+      slot[0] = (frame[0] != 0xff && frame[1] == PAD_REPLY_ID) ? 0 : 0xff;
+      slot[1] = frame[0];
+      memcpy(&slot[2], &frame[2], TAP_FRAME_SIZE - 2);
+   }
+}
+
+#ifndef PLATFORM_HOST
+
+#include <psxapi.h>
+#include <psxetc.h>
+#include <psxgpu.h>
+#include <hwregs_c.h>
+
+// SIO0 registers
+#define JOY_DATA (*(volatile uint8_t *)0x1f801040)
+#define JOY_STAT (*(volatile uint16_t *)0x1f801044)
+#define JOY_MODE (*(volatile uint16_t *)0x1f801048)
+#define JOY_CTRL (*(volatile uint16_t *)0x1f80104a)
+#define JOY_BAUD (*(volatile uint16_t *)0x1f80104e)
+
+#define JOY_STAT_RX_READY 0x0002
+#define JOY_CTRL_TX_ENABLE 0x0001
+#define JOY_CTRL_SELECT 0x0002
+#define JOY_CTRL_ACK_IRQ 0x0010
+#define JOY_CTRL_RESET 0x0040
+#define JOY_CTRL_ACK_IRQ_ENABLE 0x1000
+#define JOY_CTRL_PORT_2 0x2000
+
+// 8-bit, baud factor 1, 250 kHz
+#define JOY_MODE_PAD 0x000d
+#define JOY_BAUD_PAD 0x0088
+
+// Root counter 2 at system clock / 8: one-shot IRQ at target
+#define TIMER2_ONE_SHOT 0x0218
+#define TIMER2_STOPPED 0x0200
+
+// Timer 2 ticks per scanline, settle time after select (~20 us) and /ACK
+// timeout (~120 us)
+#define TICKS_PER_LINE_NTSC 269
+#define TICKS_PER_LINE_PAL 271
+#define SELECT_DELAY 85
+#define ACK_TIMEOUT 512
+
+#define MAX_REPLY (3 + 32)
+#define PAD_ADDRESS 0x01
+#define PAD_READ 0x42
+#define PAD_TAP_ALL 0x01
+
+typedef enum
+{
+   SIO_IDLE,
+   SIO_WAIT_LINE,
+   SIO_SELECT,
+   SIO_TRANSFER
+} SioState;
+
+static uint8_t *port_buffers[2];
+static int buffer_length = 0;
+static int poll_line = 0;
+static bool enabled = false;
+static bool suspended = false;
+static PlatformCallback poll_callback = NULL;
+static PlatformCallback chained_vsync_callback = NULL;
+
+static volatile SioState state = SIO_IDLE;
+static int port = 0;
+static int sent = 0;
+static int received = 0;
+static int expected = 0;
+static uint8_t reply[MAX_REPLY];
+
+static void arm_timer(uint16_t ticks)
+{
+   TIMER_RELOAD(2) = ticks;
+   TIMER_CTRL(2) = TIMER2_ONE_SHOT;
+}
+
+static void stop_timer(void)
+{
+   TIMER_CTRL(2) = TIMER2_STOPPED;
+}
+
+// Byte to send at position index of the exchange
+static uint8_t command_byte(int index)
+{
+   switch (index)
+   {
+   case 0:
+      return PAD_ADDRESS;
+   case 1:
+      return PAD_READ;
+   case 2:
+      return PAD_TAP_ALL;
+   default:
+      return 0x00;
+   }
+}
+
+static void send_next(void)
+{
+   JOY_DATA = command_byte(sent++);
+   arm_timer(ACK_TIMEOUT);
+}
+
+static void select_port(int index)
+{
+   port = index;
+   sent = 0;
+   received = 0;
+   expected = 3;
+
+   JOY_CTRL = JOY_CTRL_TX_ENABLE | JOY_CTRL_SELECT | JOY_CTRL_ACK_IRQ_ENABLE | (index ? JOY_CTRL_PORT_2 : 0);
+   state = SIO_SELECT;
+   arm_timer(SELECT_DELAY);
+}
+
+static void receive_byte(void)
+{
+   uint8_t value = JOY_DATA;
+
+   if (received < MAX_REPLY)
+   {
+      reply[received] = value;
+   }
+   received++;
+
+   // The id tells how many data bytes follow
+   if (received == 2)
+   {
+      expected = 3 + REPLY_DATA_LENGTH(value);
+   }
+}
+
+// Copies a finished reply to the port buffer in PADTYPE layout
+static void finish_port(void)
+{
+   uint8_t *buffer = port_buffers[port];
+
+   JOY_CTRL = 0;
+
+   if (buffer)
+   {
+      sio_pad_store_reply(buffer, buffer_length, reply, received);
+   }
+
+   if (port == 0)
+   {
+      select_port(1);
+      return;
+   }
+
+   state = SIO_IDLE;
+   stop_timer();
+
+   if (poll_callback)
+   {
+      poll_callback();
+   }
+}
+
+static void timer_handler(void)
+{
+   switch (state)
+   {
+   case SIO_WAIT_LINE:
+      select_port(0);
+      break;
+
+   case SIO_SELECT:
+      state = SIO_TRANSFER;
+      send_next();
+      break;
+
+   case SIO_TRANSFER:
+      // No /ACK: either the last byte, whose data is waiting, or no pad
+      if (JOY_STAT & JOY_STAT_RX_READY)
+      {
+         receive_byte();
+      }
+      finish_port();
+      break;
+
+   default:
+      break;
+   }
+}
+
+static void ack_handler(void)
+{
+   if (state != SIO_TRANSFER)
+   {
+      JOY_CTRL |= JOY_CTRL_ACK_IRQ;
+      return;
+   }
+
+   receive_byte();
+   JOY_CTRL |= JOY_CTRL_ACK_IRQ;
+
+   if (sent < expected)
+   {
+      send_next();
+   }
+   else
+   {
+      // Nothing else to send, the timeout ends the port
+      arm_timer(ACK_TIMEOUT);
+   }
+}
+
+static void vsync_handler(void)
+{
+   if (chained_vsync_callback)
+   {
+      chained_vsync_callback();
+   }
+
+   if (!enabled || suspended || poll_line < 0 || state != SIO_IDLE)
+   {
+      return;
+   }
+
+   if (poll_line == 0)
+   {
+      select_port(0);
+      return;
+   }
+
+   int ticks_per_line = GetVideoMode() == MODE_PAL ? TICKS_PER_LINE_PAL : TICKS_PER_LINE_NTSC;
+   int ticks = poll_line * ticks_per_line;
+
+   state = SIO_WAIT_LINE;
+   arm_timer(ticks > 0xffff ? 0xffff : (uint16_t)ticks);
+}
+
+// Puts SIO0 in pad mode, whatever the card driver left it in
+static void reset_sio(void)
+{
+   JOY_CTRL = JOY_CTRL_RESET;
+   JOY_MODE = JOY_MODE_PAD;
+   JOY_BAUD = JOY_BAUD_PAD;
+   JOY_CTRL = 0;
+}
+
+void sio_pad_init(uint8_t *port0, uint8_t *port1, int length, int line)
+{
+   port_buffers[0] = port0;
+   port_buffers[1] = port1;
+   buffer_length = length;
+   poll_line = line;
+
+   memset(port0, 0xff, length);
+   memset(port1, 0xff, length);
+
+   EnterCriticalSection();
+   reset_sio();
+   stop_timer();
+
+   InterruptCallback(IRQ_TIMER2, &timer_handler);
+   InterruptCallback(IRQ_SIO0, &ack_handler);
+
+   // Chains on whatever else the game hooked on vblank
+   chained_vsync_callback = platform_set_vsync_callback(&vsync_handler);
+   enabled = true;
+   ExitCriticalSection();
+}
+
+void sio_pad_set_poll_line(int line)
+{
+   poll_line = line;
+}
+
+void sio_pad_set_enabled(bool enable)
+{
+   enabled = enable;
+}
+
+void sio_pad_suspend(void)
+{
+   suspended = true;
+
+   // A poll takes at most a couple of milliseconds
+   while (state != SIO_IDLE)
+   {
+   }
+
+   EnterCriticalSection();
+   InterruptCallback(IRQ_SIO0, NULL);
+
+   // Detaching masked IRQ 7, which the card driver needs
+   IRQ_MASK |= 1 << IRQ_SIO0;
+   ExitCriticalSection();
+}
+
+void sio_pad_resume(void)
+{
+   EnterCriticalSection();
+   reset_sio();
+   InterruptCallback(IRQ_SIO0, &ack_handler);
+   suspended = false;
+   ExitCriticalSection();
+}
+
+void sio_pad_poll(void)
+{
+   EnterCriticalSection();
+   if (enabled && !suspended && state == SIO_IDLE)
+   {
+      select_port(0);
+   }
+   ExitCriticalSection();
+}
+
+bool sio_pad_busy(void)
+{
+   return state != SIO_IDLE;
+}
+
+void sio_pad_set_callback(PlatformCallback callback)
+{
+   poll_callback = callback;
+}
+
+#endif // PLATFORM_HOST
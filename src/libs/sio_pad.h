@@ -0,0 +1,35 @@
+#ifndef SIO_PAD_H
+#define SIO_PAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "platform.h"
+
+// Pad driver talking to SIO0 directly, see sio_pad.c. Use it through the
+// platform layer (platform_use_sio_pad_driver()).
+
+// Both ports are polled poll_line scanlines after each vblank, or only when
+// sio_pad_poll() is called with PAD_POLL_ON_DEMAND.
+void sio_pad_init(uint8_t *port0, uint8_t *port1, int length, int poll_line);
+void sio_pad_set_poll_line(int poll_line);
+void sio_pad_set_enabled(bool enabled);
+
+// Stops polling (after the running poll) and leaves SIO0 and its interrupt
+// to the BIOS memory card driver until sio_pad_resume()
+void sio_pad_suspend(void);
+void sio_pad_resume(void);
+
+// Starts polling both ports unless a poll is already running
+void sio_pad_poll(void);
+bool sio_pad_busy(void);
+
+// Called from the interrupt once both ports are updated
+void sio_pad_set_callback(PlatformCallback callback);
+
+// Stores the received bytes of one exchange (address reply first) in a port
+// buffer of length bytes: stat 0xff if the reply is incomplete or invalid,
+// otherwise stat 0, the id and the data, with multitap frames rewritten as
+// stat, id, data. Also available on the host.
+void sio_pad_store_reply(uint8_t *buffer, int length, const uint8_t *reply, int received);
+
+#endif // SIO_PAD_H
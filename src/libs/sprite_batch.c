@@ -0,0 +1,165 @@
+/**
+ * @file sprite_batch.c
+ * @brief Texture-sorted sprite drawing
+ *
+ * Drawing sprites one by one means deriving the texture page, CLUT and UVs
+ * from the TIM for every single sprite and switching GPU texture state over
+ * and over. A batch instead groups the sprites by texture, lays each group
+ * out as one DR_TPAGE followed by bare sprite packets, and writes each sprite
+ * packet as four or five precomputed words.
+ *
+ * The whole batch goes into a single contiguous block chained in memory order
+ * and is inserted into the OT with one link, no matter how many sprites it
+ * holds. A DR_TPAGE is only emitted when the page changes between groups, so
+ * textures sharing a page (e.g. same sheet, different CLUTs) should be next to
+ * each other in the texture array.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "sprite_batch.h"
+#include <assert.h>
+
+// GP0 commands for textured, unshaded rectangles
+#define SPRT_CODE 0x64
+#define SPRT_8_CODE 0x74
+#define SPRT_16_CODE 0x7c
+
+// GP0(E1h): draw mode / texture page
+#define DRAW_MODE_CODE 0xe1000000
+
+// Neutral tint, texels are drawn unmodified
+#define NEUTRAL_COLOR 0x808080
+
+// Packet header: length in words plus the address of the next packet
+#define PACKET_TAG(words, next) (((uint32_t)(words) << 24) | ((uint32_t)(uintptr_t)(next) & 0xffffff))
+
+void init_sprite_texture(SpriteTexture *texture, const TIM_IMAGE *tim, int width, int height)
+{
+   int mode = tim->mode & 0x3;
+   uint16_t clut = 0;
+   uint32_t code;
+
+   if (tim->mode & 0x8) // Check if CLUT exists
+   {
+      clut = getClut(tim->crect->x, tim->crect->y);
+   }
+
+   // prect->x is in VRAM (16-bit) units, U is in texels of the image depth.
+   int u = (tim->prect->x & 0x3f) << (2 - mode);
+   int v = tim->prect->y & 0xff;
+
+   if (width == 8 && height == 8)
+   {
+      code = SPRT_8_CODE;
+      texture->packet_words = 3;
+   }
+   else if (width == 16 && height == 16)
+   {
+      code = SPRT_16_CODE;
+      texture->packet_words = 3;
+   }
+   else
+   {
+      code = SPRT_CODE;
+      texture->packet_words = 4;
+   }
+
+   texture->tpage = getTPage(mode, 0, tim->prect->x, tim->prect->y);
+   texture->width = width;
+   texture->height = height;
+   texture->color_code = NEUTRAL_COLOR | (code << 24);
+   texture->uv_clut = (uint32_t)u | ((uint32_t)v << 8) | ((uint32_t)clut << 16);
+}
+
+void draw_sprite_batch(RenderContext *ctx, int z, const SpriteTexture *textures, int texture_count,
+                       const SpriteInstance *sprites, int sprite_count)
+{
+   uint16_t counts[SPRITE_BATCH_MAX_TEXTURES] = {0};
+   uint32_t *cursors[SPRITE_BATCH_MAX_TEXTURES];
+   size_t total_words = 0;
+   int last_texture = -1;
+   int last_tpage = -1;
+
+   assert(texture_count <= SPRITE_BATCH_MAX_TEXTURES);
+
+   if (sprite_count <= 0)
+   {
+      return;
+   }
+
+   for (int i = 0; i < sprite_count; i++)
+   {
+      assert(sprites[i].texture < texture_count);
+      counts[sprites[i].texture]++;
+   }
+
+   // Size the block: one DR_TPAGE per page change plus a tag and the sprite
+   // words for every sprite.
+   for (int t = 0; t < texture_count; t++)
+   {
+      if (!counts[t])
+      {
+         continue;
+      }
+
+      if (textures[t].tpage != last_tpage)
+      {
+         total_words += 2;
+         last_tpage = textures[t].tpage;
+      }
+      total_words += counts[t] * (1 + textures[t].packet_words);
+      last_texture = t;
+   }
+
+   uint32_t *block = (uint32_t *)allocate_packets(ctx, z, total_words * 4);
+   if (!block)
+   {
+      return;
+   }
+
+   // Write the DR_TPAGE packets and remember where each group's sprites start.
+   uint32_t *cursor = block;
+   last_tpage = -1;
+   for (int t = 0; t < texture_count; t++)
+   {
+      if (!counts[t])
+      {
+         continue;
+      }
+
+      if (textures[t].tpage != last_tpage)
+      {
+         cursor[0] = PACKET_TAG(1, &cursor[2]);
+         cursor[1] = DRAW_MODE_CODE | textures[t].tpage;
+         cursor += 2;
+         last_tpage = textures[t].tpage;
+      }
+
+      cursors[t] = cursor;
+      cursor += counts[t] * (1 + textures[t].packet_words);
+   }
+
+   // Scatter the sprites into their groups. Packets are chained in memory
+   // order, so each one simply links to the words right after it.
+   for (int i = 0; i < sprite_count; i++)
+   {
+      const SpriteTexture *texture = &textures[sprites[i].texture];
+      uint32_t *packet = cursors[sprites[i].texture];
+      int words = texture->packet_words;
+
+      packet[0] = PACKET_TAG(words, &packet[1 + words]);
+      packet[1] = texture->color_code;
+      packet[2] = ((uint32_t)(uint16_t)sprites[i].y << 16) | (uint16_t)sprites[i].x;
+      packet[3] = texture->uv_clut;
+      if (words == 4)
+      {
+         packet[4] = ((uint32_t)texture->height << 16) | texture->width;
+      }
+
+      cursors[sprites[i].texture] += 1 + words;
+   }
+
+   uint32_t *last = &block[total_words - (1 + textures[last_texture].packet_words)];
+   link_packet_chain(ctx, z, block, last);
+}
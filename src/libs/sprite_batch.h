@@ -0,0 +1,32 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <stdint.h>
+#include "platform.h"
+#include "render_context.h"
+
+// Maximum number of distinct textures a single batch can reference
+#define SPRITE_BATCH_MAX_TEXTURES 16
+
+// Texture state shared by every sprite drawn from the same image. All packet
+// words that do not depend on the sprite position are precomputed here.
+typedef struct
+{
+   uint16_t tpage;
+   uint16_t width, height;
+   uint8_t packet_words; // 3 for SPRT_8/SPRT_16, 4 for SPRT
+   uint32_t color_code;  // RGB tint + GP0 command
+   uint32_t uv_clut;     // UV offset inside the page + CLUT id
+} SpriteTexture;
+
+typedef struct
+{
+   int16_t x, y;
+   uint8_t texture; // Index into the texture array passed to draw_sprite_batch()
+} SpriteInstance;
+
+void init_sprite_texture(SpriteTexture *texture, const TIM_IMAGE *tim, int width, int height);
+void draw_sprite_batch(RenderContext *ctx, int z, const SpriteTexture *textures, int texture_count,
+                       const SpriteInstance *sprites, int sprite_count);
+
+#endif // SPRITE_BATCH_H
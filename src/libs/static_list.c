@@ -0,0 +1,134 @@
+/**
+ * @file static_list.c
+ * @brief Pre-built packet chains for content that never changes
+ *
+ * Static content (the center line, menu text...) used to be regenerated into
+ * the packet buffer every frame. A StaticDisplayList is built once into
+ * persistent memory and then linked into an OT slot with two pointer writes.
+ *
+ * Linking a chain means pointing its last packet at the rest of the OT, and
+ * that pointer is different for every buffer's OT. Since the GPU may still be
+ * walking the previous buffer while the CPU links the next one, finalizing a
+ * list duplicates it once per render buffer (relocating the internal links),
+ * so each buffer only ever touches its own copy.
+ *
+ * Usage:
+ * 1. init_static_list() with memory sized by STATIC_LIST_WORDS()
+ * 2. static_list_primitive() / static_list_text() to build it
+ * 3. finalize_static_list()
+ * 4. link_static_list() every frame
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "static_list.h"
+#include <assert.h>
+#include <string.h>
+
+#define LIST_END 0xffffff
+
+void init_static_list(StaticDisplayList *list, uint32_t *memory, size_t words)
+{
+   list->memory = (uint8_t *)memory;
+   list->capacity = (words / MAX_RENDER_BUFFERS) * 4;
+   list->used = 0;
+   list->first_offset = 0;
+   list->last_offset = 0;
+   list->finalized = false;
+   list->linked = false;
+   list->linked_frame = 0;
+
+   termPrim(&(list->head));
+}
+
+// Appends a primitive to the list. Like with new_primitive(), primitives added
+// later are drawn first.
+void *static_list_primitive(StaticDisplayList *list, size_t size)
+{
+   assert(!list->finalized);
+   assert(list->used + size <= list->capacity);
+
+   uint8_t *prim = &(list->memory[list->used]);
+
+   addPrim(&(list->head), prim);
+   list->used += size;
+
+   return (void *)prim;
+}
+
+void static_list_text(StaticDisplayList *list, int x, int y, const char *text)
+{
+   assert(!list->finalized);
+   assert(list->used + FNT_SORT_SIZE(strlen(text)) <= list->capacity);
+
+   uint8_t *start = &(list->memory[list->used]);
+   uint8_t *end = (uint8_t *)FntSort(&(list->head), (char *)start, x, y, text);
+
+   list->used += (size_t)(end - start);
+}
+
+static size_t packet_offset(const StaticDisplayList *list, uint32_t addr)
+{
+   return (size_t)((addr - (uint32_t)(uintptr_t)list->memory) & LIST_END);
+}
+
+void finalize_static_list(StaticDisplayList *list)
+{
+   assert(!list->finalized);
+   assert(!isendprim(&(list->head)));
+
+   list->first_offset = packet_offset(list, getaddr(&(list->head)));
+
+   // Duplicate the chain for every other buffer and point the copies' links at
+   // their own packets.
+   for (int i = 1; i < MAX_RENDER_BUFFERS; i++)
+   {
+      uint8_t *copy = &(list->memory[i * list->capacity]);
+
+      memcpy(copy, list->memory, list->used);
+   }
+
+   size_t offset = list->first_offset;
+   for (;;)
+   {
+      uint32_t *packet = (uint32_t *)&(list->memory[offset]);
+
+      if (isendprim(packet))
+      {
+         break;
+      }
+
+      size_t next = packet_offset(list, getaddr(packet));
+      for (int i = 1; i < MAX_RENDER_BUFFERS; i++)
+      {
+         uint8_t *copy = &(list->memory[i * list->capacity]);
+
+         setaddr((uint32_t *)&(copy[offset]), &(copy[next]));
+      }
+
+      offset = next;
+   }
+
+   list->last_offset = offset;
+   list->finalized = true;
+}
+
+// Splice the buffer's copy of the list into OT slot z in O(1). Linking it a
+// second time in a frame would point its tail back into the OT ahead of
+// itself, a loop the GPU never leaves, so that link is skipped.
+void link_static_list(RenderContext *ctx, StaticDisplayList *list, int z)
+{
+   uint8_t *copy = &(list->memory[ctx->active_buffer * list->capacity]);
+   bool linked = list->linked && list->linked_frame == ctx->frame_number;
+
+   assert(!linked);
+   if (linked)
+   {
+      return;
+   }
+
+   list->linked = true;
+   list->linked_frame = ctx->frame_number;
+
+   link_packet_chain(ctx, z, &(copy[list->first_offset]), &(copy[list->last_offset]));
+}
@@ -0,0 +1,36 @@
+#ifndef STATIC_LIST_H
+#define STATIC_LIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "render_context.h"
+
+// Number of uint32_t words a static list holding up to `bytes` of packets
+// needs. One copy is kept per render buffer, see static_list.c.
+#define STATIC_LIST_WORDS(bytes) ((((bytes) + 3) / 4) * MAX_RENDER_BUFFERS)
+
+// A packet chain built once and linked into an OT slot every frame
+typedef struct
+{
+   uint8_t *memory;
+   size_t capacity; // Bytes available to each copy
+   size_t used;
+
+   uint32_t head; // Build-time list head, behaves like a single OT entry
+   size_t first_offset;
+   size_t last_offset;
+   bool finalized;
+   bool linked;
+   uint32_t linked_frame; // RenderContext frame_number it was last linked in
+} StaticDisplayList;
+
+void init_static_list(StaticDisplayList *list, uint32_t *memory, size_t words);
+void *static_list_primitive(StaticDisplayList *list, size_t size);
+void static_list_text(StaticDisplayList *list, int x, int y, const char *text);
+void finalize_static_list(StaticDisplayList *list);
+
+// Once per frame: the buffer's copy can only be in one place of the OT
+void link_static_list(RenderContext *ctx, StaticDisplayList *list, int z);
+
+#endif // STATIC_LIST_H
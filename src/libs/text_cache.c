@@ -0,0 +1,220 @@
+/**
+ * @file text_cache.c
+ * @brief Debug font text kept as cached glyph packets
+ *
+ * draw_text() runs FntSort(), which walks the string and writes a fresh
+ * SPRT_8 for every character into the packet buffer each frame. Most text on
+ * screen never changes, and the text that does (scores) only changes a
+ * character at a time.
+ *
+ * draw_cached_text() is a drop-in replacement keyed by position: the first
+ * call at a given (x, y) turns the string into a run of glyph packets stored
+ * outside the packet buffer, and later calls compare the new string against
+ * the cached one, rewrite only the glyphs that differ and re-link the run into
+ * the OT. Every character keeps a fixed packet slot, spaces become empty
+ * (zero length) packets so the other glyphs don't move.
+ *
+ * A run can only be linked once per frame, linking it again would make a
+ * loop in the OT: a second string at the same position in one frame, or one
+ * more string than there are entries, goes through draw_text() instead.
+ *
+ * The glyph table (UVs, CLUT, texture page) is not hardcoded; init_text_cache()
+ * runs FntSort() once over all printable characters and reads it back from the
+ * generated packets, so it always matches what FntLoad() uploaded.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "text_cache.h"
+#include <assert.h>
+#include <string.h>
+
+#define FIRST_GLYPH 33
+#define LAST_GLYPH 126
+#define GLYPH_COUNT (LAST_GLYPH - FIRST_GLYPH + 1)
+#define GLYPH_SIZE 8
+
+#define SPRT_8_WORDS 3
+#define SLOT_WORDS (1 + SPRT_8_WORDS)
+
+#define PACKET_TAG(words, next) (((uint32_t)(words) << 24) | ((uint32_t)(uintptr_t)(next) & 0xffffff))
+
+static TextRun runs[TEXT_CACHE_ENTRIES];
+
+// Glyph table read back from FntSort()
+static uint32_t glyph_tpage_code;
+static uint32_t glyph_color_code;
+static uint16_t glyph_uv[GLYPH_COUNT];
+static uint16_t glyph_clut;
+static bool glyph_present[GLYPH_COUNT];
+
+// Must be called after FntLoad().
+void init_text_cache(void)
+{
+   char probe_text[GLYPH_COUNT + 1];
+   uint32_t head = 0;
+
+   // The run storage doubles as FntSort() scratch space: it is cleared below
+   // anyway, and packet memory has to be static for the host build, whose
+   // 24-bit packet links cannot reach the stack.
+   uint32_t *probe_packets = (uint32_t *)runs;
+
+   assert(sizeof(runs) >= FNT_SORT_SIZE(GLYPH_COUNT));
+
+   for (int i = 0; i < GLYPH_COUNT; i++)
+   {
+      probe_text[i] = (char)(FIRST_GLYPH + i);
+   }
+   probe_text[GLYPH_COUNT] = 0;
+
+   termPrim(&head);
+   FntSort(&head, (char *)probe_packets, 0, 0, probe_text);
+
+   memset(glyph_present, 0, sizeof(glyph_present));
+
+   // Walk the generated chain: sprites are identified by their GP0 command and
+   // mapped back to a character by their X position.
+   uint32_t *packet = (uint32_t *)&head;
+   while (!isendprim(packet))
+   {
+      packet = (uint32_t *)nextPrim(packet);
+
+      uint8_t code = (uint8_t)(packet[1] >> 24);
+
+      if (code == 0xe1)
+      {
+         glyph_tpage_code = packet[1];
+      }
+      else if ((code & 0xfc) == 0x74)
+      {
+         int glyph = (int16_t)(packet[2] & 0xffff) / GLYPH_SIZE;
+
+         if (glyph >= 0 && glyph < GLYPH_COUNT)
+         {
+            glyph_color_code = packet[1];
+            glyph_uv[glyph] = (uint16_t)(packet[3] & 0xffff);
+            glyph_clut = (uint16_t)(packet[3] >> 16);
+            glyph_present[glyph] = true;
+         }
+      }
+   }
+
+   memset(runs, 0, sizeof(runs));
+}
+
+// Rewrite a character slot. Slots always link to the next one in memory; the
+// last slot's link is overwritten when the run gets linked into the OT.
+static void write_glyph(TextRun *run, uint32_t *packets, int index, char c)
+{
+   uint32_t *slot = &packets[2 + index * SLOT_WORDS];
+   int glyph = (uint8_t)c - FIRST_GLYPH;
+
+   if (glyph < 0 || glyph >= GLYPH_COUNT || !glyph_present[glyph])
+   {
+      slot[0] = PACKET_TAG(0, &slot[SLOT_WORDS]);
+      return;
+   }
+
+   slot[0] = PACKET_TAG(SPRT_8_WORDS, &slot[SLOT_WORDS]);
+   slot[1] = glyph_color_code;
+   slot[2] = ((uint32_t)(uint16_t)run->y << 16) | (uint16_t)(run->x + index * GLYPH_SIZE);
+   slot[3] = ((uint32_t)glyph_clut << 16) | glyph_uv[glyph];
+}
+
+// Find the run cached at (x, y), or recycle the least recently used one.
+// Runs already linked in this frame are left alone, NULL if that is all of
+// them.
+static TextRun *find_run(const RenderContext *ctx, int x, int y)
+{
+   TextRun *oldest = NULL;
+
+   for (int i = 0; i < TEXT_CACHE_ENTRIES; i++)
+   {
+      TextRun *run = &runs[i];
+      bool linked = run->in_use && run->linked_frame == ctx->frame_number;
+
+      if (run->in_use && run->x == x && run->y == y)
+      {
+         return linked ? NULL : run;
+      }
+      if (linked)
+      {
+         continue;
+      }
+      if (!oldest || !run->in_use ||
+          (oldest->in_use && ctx->frame_number - run->linked_frame > ctx->frame_number - oldest->linked_frame))
+      {
+         oldest = run;
+      }
+   }
+
+   if (!oldest)
+   {
+      return NULL;
+   }
+
+   // Each copy is only ever touched while its own buffer is being built, so
+   // recycling is safe even if another buffer's copy is still being drawn.
+   oldest->x = x;
+   oldest->y = y;
+   oldest->in_use = true;
+   for (int i = 0; i < MAX_RENDER_BUFFERS; i++)
+   {
+      oldest->length[i] = -1;
+   }
+
+   return oldest;
+}
+
+void draw_cached_text(RenderContext *ctx, int x, int y, int z, const char *text)
+{
+   size_t length = strlen(text);
+
+   TextRun *run = length <= TEXT_CACHE_MAX_LENGTH ? find_run(ctx, x, y) : NULL;
+
+   if (!run)
+   {
+      draw_text(ctx, x, y, z, text);
+      return;
+   }
+
+   int copy = ctx->active_buffer;
+   uint32_t *packets = run->packets[copy];
+   char *cached = run->text[copy];
+   int old_length = run->length[copy];
+
+   run->linked_frame = ctx->frame_number;
+
+   // The DR_TPAGE link may have been pointed at the OT if the string was empty
+   // last time, so it is always rewritten.
+   packets[0] = PACKET_TAG(1, &packets[2]);
+
+   if (old_length < 0)
+   {
+      packets[1] = glyph_tpage_code;
+
+      for (int i = 0; i < (int)length; i++)
+      {
+         write_glyph(run, packets, i, text[i]);
+         cached[i] = text[i];
+      }
+   }
+   else
+   {
+      // Only touch glyphs that changed, plus the slot that used to be last as
+      // its link was pointed at the OT.
+      for (int i = 0; i < (int)length; i++)
+      {
+         if (i >= old_length || cached[i] != text[i] || i == old_length - 1)
+         {
+            write_glyph(run, packets, i, text[i]);
+            cached[i] = text[i];
+         }
+      }
+   }
+
+   run->length[copy] = (int8_t)length;
+
+   uint32_t *last = length ? &packets[2 + (length - 1) * SLOT_WORDS] : packets;
+   link_packet_chain(ctx, z, packets, last);
+}
@@ -0,0 +1,33 @@
+#ifndef TEXT_CACHE_H
+#define TEXT_CACHE_H
+
+#include <stdint.h>
+#include "render_context.h"
+
+// Number of strings that can be cached at the same time
+#define TEXT_CACHE_ENTRIES 8
+
+// Longest string that can be cached, longer ones fall back to draw_text()
+#define TEXT_CACHE_MAX_LENGTH 32
+
+// Packet words per copy: one DR_TPAGE plus a SPRT_8 slot per character
+#define TEXT_RUN_WORDS (2 + 4 * TEXT_CACHE_MAX_LENGTH)
+
+// A string drawn at a fixed position, kept as ready-made glyph packets. Each
+// render buffer has its own copy so it can be updated and linked while the
+// GPU is drawing another buffer.
+typedef struct
+{
+   int16_t x, y;
+   bool in_use;
+   uint32_t linked_frame; // RenderContext frame_number it was last linked in
+
+   int8_t length[MAX_RENDER_BUFFERS]; // -1 if the copy was never built
+   char text[MAX_RENDER_BUFFERS][TEXT_CACHE_MAX_LENGTH];
+   uint32_t packets[MAX_RENDER_BUFFERS][TEXT_RUN_WORDS];
+} TextRun;
+
+void init_text_cache(void);
+void draw_cached_text(RenderContext *ctx, int x, int y, int z, const char *text);
+
+#endif // TEXT_CACHE_H
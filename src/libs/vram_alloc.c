@@ -0,0 +1,393 @@
+/**
+ * @file vram_alloc.c
+ * @brief Runtime VRAM placement for TIM textures
+ *
+ * png2tim bakes a fixed VRAM position into every TIM, so nothing kept two
+ * textures (or a texture and a framebuffer) from overlapping. The allocator
+ * instead picks a free spot for each TIM when it is loaded and uploads it
+ * there; the coordinates baked into the file are ignored.
+ *
+ * Pixel data is packed per texture page: a page (64x256 VRAM units) is split
+ * into 4x16 cells of 16x16 units and its used cells fit in one 64-bit mask.
+ * An image can span cells of several pages side by side, but never two page
+ * rows, so V stays within 0-255. It is placed so that the tpage of its first
+ * page reaches all of it (256 texels: 64 units at 4-bit, 128 at 8-bit, 256 at
+ * 16-bit); an image wider than that starts at a page boundary instead, so
+ * every 256 texel strip of it starts at a page (vram_tpage()).
+ *
+ * CLUTs go to a separate area made of rows of 16-entry slots, 16 slots for a
+ * 256-color CLUT. The area is usually spare VRAM next to the framebuffers.
+ *
+ * Textures are reference counted. Released textures stay in VRAM, so loading
+ * the same TIM again costs nothing, until space is needed: then the least
+ * recently used texture nobody references is evicted. Textures touched in a
+ * frame the GPU may still be drawing (vram_set_frames()) are not evicted
+ * until that frame's DrawSync, so their cells aren't reused under it.
+ *
+ * Usage:
+ * 1. init_vram_allocator() with the CLUT area
+ * 2. vram_reserve() everything else that lives in VRAM (framebuffers, font)
+ * 3. vram_load_tim() / vram_release() as textures come and go, vram_touch()
+ *    when a texture is drawn so it is evicted last
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include "vram_alloc.h"
+#include <assert.h>
+#include <string.h>
+
+#define CELL_SIZE 16
+#define PAGE_COLUMNS 16
+#define PAGE_CELLS_X 4
+#define PAGE_CELLS_Y 16
+#define CLUT_SLOT_SIZE 16
+#define VRAM_CELLS_X 64
+#define PAGE_UNITS 64
+#define PAGE_TEXELS 256
+
+#define HAS_CLUT(image) ((image)->mode & 0x8)
+
+// Page and mask bit of cell (cx, cy) of the whole VRAM
+static uint64_t cell_bit(int cx, int cy, int *page)
+{
+   *page = (cy / PAGE_CELLS_Y) * PAGE_COLUMNS + cx / PAGE_CELLS_X;
+   return 1ull << ((cy % PAGE_CELLS_Y) * PAGE_CELLS_X + cx % PAGE_CELLS_X);
+}
+
+// VRAM units the 256 texels of a tpage cover at the image's depth
+static int page_reach(int mode)
+{
+   switch (mode & 3)
+   {
+   case 0:
+      return PAGE_UNITS;
+   case 1:
+      return PAGE_UNITS * 2;
+   default:
+      return PAGE_UNITS * 4;
+   }
+}
+
+static void set_cells(VramAllocator *vram, const RECT *rect, bool used)
+{
+   int x0 = rect->x / CELL_SIZE;
+   int y0 = rect->y / CELL_SIZE;
+   int x1 = (rect->x + rect->w - 1) / CELL_SIZE;
+   int y1 = (rect->y + rect->h - 1) / CELL_SIZE;
+
+   for (int cy = y0; cy <= y1; cy++)
+   {
+      for (int cx = x0; cx <= x1; cx++)
+      {
+         int page;
+         uint64_t bit = cell_bit(cx, cy, &page);
+
+         if (used)
+         {
+            vram->cells[page] |= bit;
+         }
+         else
+         {
+            vram->cells[page] &= ~bit;
+         }
+      }
+   }
+}
+
+static bool cells_free(const VramAllocator *vram, int x0, int y0, int columns, int rows)
+{
+   for (int cy = y0; cy < y0 + rows; cy++)
+   {
+      for (int cx = x0; cx < x0 + columns; cx++)
+      {
+         int page;
+         uint64_t bit = cell_bit(cx, cy, &page);
+
+         if (vram->cells[page] & bit)
+         {
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+// Finds room for a w x h image (in VRAM units) starting in a texture page and
+// spreading right into the next ones if needed, first fit.
+static bool find_cells(const VramAllocator *vram, int w, int h, int mode, RECT *rect)
+{
+   int columns = (w + CELL_SIZE - 1) / CELL_SIZE;
+   int rows = (h + CELL_SIZE - 1) / CELL_SIZE;
+   int reach = page_reach(mode);
+
+   if (columns > VRAM_CELLS_X || rows > PAGE_CELLS_Y)
+   {
+      return false;
+   }
+
+   for (int page = 0; page < VRAM_PAGE_COUNT; page++)
+   {
+      int page_x = (page % PAGE_COLUMNS) * PAGE_CELLS_X;
+      int page_y = (page / PAGE_COLUMNS) * PAGE_CELLS_Y;
+
+      for (int row = 0; row + rows <= PAGE_CELLS_Y; row++)
+      {
+         for (int column = 0; column < PAGE_CELLS_X && page_x + column + columns <= VRAM_CELLS_X; column++)
+         {
+            // Past the page's reach, only whole strips from a page boundary
+            if (column && column * CELL_SIZE + w > reach)
+            {
+               break;
+            }
+
+            if (cells_free(vram, page_x + column, page_y + row, columns, rows))
+            {
+               setRECT(rect, (page_x + column) * CELL_SIZE, (page_y + row) * CELL_SIZE, w, h);
+               return true;
+            }
+         }
+      }
+   }
+
+   return false;
+}
+
+static uint64_t clut_run(const VramAllocator *vram, const RECT *rect)
+{
+   int slots = (rect->w + CLUT_SLOT_SIZE - 1) / CLUT_SLOT_SIZE;
+   int first = (rect->x - vram->clut_area.x) / CLUT_SLOT_SIZE;
+
+   return (slots == 64 ? ~0ull : (1ull << slots) - 1) << first;
+}
+
+static void set_clut_slots(VramAllocator *vram, const RECT *rect, bool used)
+{
+   uint64_t run = clut_run(vram, rect);
+
+   for (int r = 0; r < rect->h; r++)
+   {
+      int row = rect->y - vram->clut_area.y + r;
+
+      if (used)
+      {
+         vram->clut_slots[row] |= run;
+      }
+      else
+      {
+         vram->clut_slots[row] &= ~run;
+      }
+   }
+}
+
+// Finds a run of free slots, at the same position in h consecutive rows
+static bool find_clut_slots(const VramAllocator *vram, int w, int h, RECT *rect)
+{
+   int slots = (w + CLUT_SLOT_SIZE - 1) / CLUT_SLOT_SIZE;
+   int row_slots = vram->clut_area.w / CLUT_SLOT_SIZE;
+
+   for (int row = 0; row + h <= vram->clut_area.h; row++)
+   {
+      for (int slot = 0; slot + slots <= row_slots; slot++)
+      {
+         setRECT(rect, vram->clut_area.x + slot * CLUT_SLOT_SIZE, vram->clut_area.y + row, w, h);
+
+         uint64_t run = clut_run(vram, rect);
+         bool available = true;
+
+         for (int r = 0; r < h && available; r++)
+         {
+            available = !(vram->clut_slots[row + r] & run);
+         }
+
+         if (available)
+         {
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+// Frees the least recently used texture that isn't referenced anymore
+static bool evict_texture(VramAllocator *vram)
+{
+   VramTexture *oldest = NULL;
+
+   for (int i = 0; i < VRAM_MAX_TEXTURES; i++)
+   {
+      VramTexture *texture = &(vram->textures[i]);
+
+      // Still sampled by a frame the GPU hasn't finished
+      if (texture->resident && (int32_t)(vram->drawn_frame - texture->last_frame) < 0)
+      {
+         continue;
+      }
+
+      if (texture->resident && !texture->references &&
+          (!oldest || texture->last_used < oldest->last_used))
+      {
+         oldest = texture;
+      }
+   }
+
+   if (!oldest)
+   {
+      return false;
+   }
+
+   set_cells(vram, &(oldest->prect), false);
+   if (HAS_CLUT(&(oldest->image)))
+   {
+      set_clut_slots(vram, &(oldest->crect), false);
+   }
+   oldest->resident = false;
+   vram->evictions++;
+
+   return true;
+}
+
+// Places the texture's pixels and CLUT, evicting textures until they fit
+static bool place_texture(VramAllocator *vram, VramTexture *texture, const TIM_IMAGE *image)
+{
+   for (;;)
+   {
+      if (find_cells(vram, image->prect->w, image->prect->h, image->mode, &(texture->prect)))
+      {
+         if (!HAS_CLUT(image) ||
+             find_clut_slots(vram, image->crect->w, image->crect->h, &(texture->crect)))
+         {
+            set_cells(vram, &(texture->prect), true);
+            if (HAS_CLUT(image))
+            {
+               set_clut_slots(vram, &(texture->crect), true);
+            }
+            return true;
+         }
+      }
+
+      if (!evict_texture(vram))
+      {
+         return false;
+      }
+   }
+}
+
+void init_vram_allocator(VramAllocator *vram, const RECT *clut_area)
+{
+   assert(clut_area->h <= VRAM_MAX_CLUT_ROWS && clut_area->w <= 64 * CLUT_SLOT_SIZE);
+
+   memset(vram, 0, sizeof(*vram));
+   vram->clut_area = *clut_area;
+   vram_reserve(vram, clut_area);
+}
+
+// Keeps textures out of a VRAM area, rounded out to whole 16x16 cells
+void vram_reserve(VramAllocator *vram, const RECT *rect)
+{
+   set_cells(vram, rect, true);
+}
+
+// Uploads a TIM and returns a handle with one reference, or returns the
+// handle of the copy already in VRAM. VRAM_INVALID_HANDLE if it's not a TIM
+// or doesn't fit even after evicting every unreferenced texture that no frame
+// in flight uses; the latter may succeed again a frame or two later.
+VramHandle vram_load_tim(VramAllocator *vram, const uint32_t *tim)
+{
+   VramTexture *slot = NULL;
+   TIM_IMAGE image;
+
+   for (int i = 0; i < VRAM_MAX_TEXTURES; i++)
+   {
+      VramTexture *texture = &(vram->textures[i]);
+
+      if (texture->resident && texture->tim == tim)
+      {
+         texture->references++;
+         vram_touch(vram, i);
+         return i;
+      }
+      if (!texture->resident && !slot)
+      {
+         slot = texture;
+      }
+   }
+
+   if (GetTimInfo(tim, &image))
+   {
+      return VRAM_INVALID_HANDLE;
+   }
+
+   // Every slot holds a texture, free the oldest unused one
+   if (!slot)
+   {
+      if (!evict_texture(vram))
+      {
+         return VRAM_INVALID_HANDLE;
+      }
+      return vram_load_tim(vram, tim);
+   }
+
+   if (!place_texture(vram, slot, &image))
+   {
+      return VRAM_INVALID_HANDLE;
+   }
+
+   platform_load_image(&(slot->prect), image.paddr);
+   if (HAS_CLUT(&image))
+   {
+      platform_load_image(&(slot->crect), image.caddr);
+   }
+
+   slot->tim = tim;
+   slot->image = image;
+   slot->image.prect = &(slot->prect);
+   slot->image.crect = HAS_CLUT(&image) ? &(slot->crect) : NULL;
+   slot->references = 1;
+   slot->resident = true;
+
+   VramHandle handle = (VramHandle)(slot - vram->textures);
+   vram_touch(vram, handle);
+   return handle;
+}
+
+// Drops a reference. The texture stays in VRAM until its space is needed.
+void vram_release(VramAllocator *vram, VramHandle handle)
+{
+   VramTexture *texture = &(vram->textures[handle]);
+
+   assert(texture->resident && texture->references > 0);
+   texture->references--;
+}
+
+// Marks a texture as recently used, to be evicted last
+void vram_touch(VramAllocator *vram, VramHandle handle)
+{
+   vram->textures[handle].last_used = ++vram->clock;
+   vram->textures[handle].last_frame = vram->frame;
+}
+
+void vram_set_frames(VramAllocator *vram, uint32_t frame, uint32_t drawn_frame)
+{
+   vram->frame = frame;
+   vram->drawn_frame = drawn_frame;
+}
+
+// TIM_IMAGE with the texture's actual VRAM position, e.g. for
+// init_sprite_texture(). Valid while the handle is referenced.
+const TIM_IMAGE *vram_image(const VramAllocator *vram, VramHandle handle)
+{
+   return &(vram->textures[handle].image);
+}
+
+// Texture page covering texel column u of the image. A wide image has one
+// per 256 texel strip.
+uint16_t vram_tpage(const VramAllocator *vram, VramHandle handle, int u)
+{
+   const VramTexture *texture = &(vram->textures[handle]);
+   int x = texture->prect.x + (u / PAGE_TEXELS) * page_reach(texture->image.mode);
+
+   return getTPage(texture->image.mode & 3, 0, x, texture->prect.y);
+}
@@ -0,0 +1,59 @@
+#ifndef VRAM_ALLOC_H
+#define VRAM_ALLOC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "platform.h"
+
+// Texture pages are 64x256 VRAM units, 16 across and 2 down
+#define VRAM_PAGE_COUNT 32
+
+// Textures that can be resident (or cached) at once
+#define VRAM_MAX_TEXTURES 32
+
+// Most rows the CLUT area can have
+#define VRAM_MAX_CLUT_ROWS 32
+
+typedef int VramHandle;
+#define VRAM_INVALID_HANDLE (-1)
+
+typedef struct
+{
+   const uint32_t *tim; // Source data, also identifies the texture
+   TIM_IMAGE image;     // prect/crect point at the rects below
+   RECT prect;
+   RECT crect;
+   uint16_t references;
+   uint32_t last_used;
+   uint32_t last_frame; // Frame it was last touched in, see vram_set_frames()
+   bool resident;
+} VramTexture;
+
+typedef struct
+{
+   uint64_t cells[VRAM_PAGE_COUNT]; // Used 16x16 cells of each page
+   RECT clut_area;
+   uint64_t clut_slots[VRAM_MAX_CLUT_ROWS]; // Used 16-entry slots of each row
+   VramTexture textures[VRAM_MAX_TEXTURES];
+   uint32_t clock;
+   uint32_t evictions;
+
+   // Frame being built and last frame the GPU finished drawing
+   uint32_t frame;
+   uint32_t drawn_frame;
+} VramAllocator;
+
+void init_vram_allocator(VramAllocator *vram, const RECT *clut_area);
+void vram_reserve(VramAllocator *vram, const RECT *rect);
+
+VramHandle vram_load_tim(VramAllocator *vram, const uint32_t *tim);
+void vram_release(VramAllocator *vram, VramHandle handle);
+void vram_touch(VramAllocator *vram, VramHandle handle);
+const TIM_IMAGE *vram_image(const VramAllocator *vram, VramHandle handle);
+uint16_t vram_tpage(const VramAllocator *vram, VramHandle handle, int u);
+
+// Once per frame with the RenderContext's frame_number and drawn_frame, so
+// that textures touched in a frame still in flight aren't evicted.
+void vram_set_frames(VramAllocator *vram, uint32_t frame, uint32_t drawn_frame);
+
+#endif // VRAM_ALLOC_H
@@ -2,119 +2,30 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <psxsio.h>
-#include <psxgpu.h>
-#include <sys/types.h>
+#include <string.h>
+#include "libs/platform.h"
 #include "libs/game_pad.h"
 #include "libs/numeric.h"
 #include "libs/math.h"
-
-// Length of the ordering table, i.e. the range Z coordinates can have, 0-15 in
-// this case. Larger values will allow for more granularity with depth (useful
-// when drawing a complex 3D scene) at the expense of RAM usage and performance.
-#define OT_LENGTH 16
-
-// Size of the buffer GPU commands and primitives are written to. If the program
-// crashes due to too many primitives being drawn, increase this value.
-#define BUFFER_LENGTH 8192
+#include "libs/render_context.h"
+#include "libs/profiler.h"
+#include "libs/gpu_trace.h"
+#include "libs/static_list.h"
+#include "libs/ot_layer.h"
+#include "libs/prim_template.h"
+#include "libs/sprite_batch.h"
+#include "libs/text_cache.h"
+#include "libs/format.h"
+#include "libs/vram_alloc.h"
+#include "libs/asset_loader.h"
+#include "libs/frame_clock.h"
+#include "libs/input_record.h"
+#include "libs/input_latency.h"
+#include "assets/assets.h"
 
 // region images
-extern u_long tim_ball16c[];
 // endregion
 
-/* Framebuffer/display list class */
-
-typedef struct
-{
-   DISPENV disp_env;
-   DRAWENV draw_env;
-
-   uint32_t ot[OT_LENGTH];
-   uint8_t buffer[BUFFER_LENGTH];
-} RenderBuffer;
-
-typedef struct
-{
-   RenderBuffer buffers[2];
-   uint8_t *next_packet;
-   int active_buffer;
-} RenderContext;
-
-void initialize_render_context(RenderContext *ctx, int w, int h, int r, int g, int b)
-{
-   // Place the two framebuffers vertically in VRAM.
-   SetDefDrawEnv(&(ctx->buffers[0].draw_env), 0, 0, w, h);
-   SetDefDispEnv(&(ctx->buffers[0].disp_env), 0, 0, w, h);
-   SetDefDrawEnv(&(ctx->buffers[1].draw_env), 0, h, w, h);
-   SetDefDispEnv(&(ctx->buffers[1].disp_env), 0, h, w, h);
-
-   // Set the default background color and enable auto-clearing.
-   setRGB0(&(ctx->buffers[0].draw_env), r, g, b);
-   setRGB0(&(ctx->buffers[1].draw_env), r, g, b);
-   ctx->buffers[0].draw_env.isbg = 1;
-   ctx->buffers[1].draw_env.isbg = 1;
-
-   // Initialize the first buffer and clear its OT so that it can be used for
-   // drawing.
-   ctx->active_buffer = 0;
-   ctx->next_packet = ctx->buffers[0].buffer;
-   ClearOTagR(ctx->buffers[0].ot, OT_LENGTH);
-
-   // Turn on the video output.
-   SetDispMask(1);
-}
-
-void flip_buffers(RenderContext *ctx)
-{
-   // Wait for the GPU to finish drawing, then wait for vblank in order to
-   // prevent screen tearing.
-   DrawSync(0);
-   VSync(0);
-
-   RenderBuffer *draw_buffer = &(ctx->buffers[ctx->active_buffer]);
-   RenderBuffer *disp_buffer = &(ctx->buffers[ctx->active_buffer ^ 1]);
-
-   // Display the framebuffer the GPU has just finished drawing and start
-   // rendering the display list that was filled up in the main loop.
-   PutDispEnv(&(disp_buffer->disp_env));
-   DrawOTagEnv(&(draw_buffer->ot[OT_LENGTH - 1]), &(draw_buffer->draw_env));
-
-   // Switch over to the next buffer, clear it and reset the packet allocation
-   // pointer.
-   ctx->active_buffer ^= 1;
-   ctx->next_packet = disp_buffer->buffer;
-   ClearOTagR(disp_buffer->ot, OT_LENGTH);
-}
-
-void *new_primitive(RenderContext *ctx, int z, size_t size)
-{
-   // Place the primitive after all previously allocated primitives, then
-   // insert it into the OT and bump the allocation pointer.
-   RenderBuffer *buffer = &(ctx->buffers[ctx->active_buffer]);
-   uint8_t *prim = ctx->next_packet;
-
-   addPrim(&(buffer->ot[z]), prim);
-   ctx->next_packet += size;
-
-   // Make sure we haven't yet run out of space for future primitives.
-   assert(ctx->next_packet <= &(buffer->buffer[BUFFER_LENGTH]));
-
-   return (void *)prim;
-}
-
-// A simple helper for drawing text using PSn00bSDK's debug font API. Note that
-// FntSort() requires the debug font texture to be uploaded to VRAM beforehand
-// by calling FntLoad().
-void draw_text(RenderContext *ctx, int x, int y, int z, const char *text)
-{
-   RenderBuffer *buffer = &(ctx->buffers[ctx->active_buffer]);
-
-   ctx->next_packet = (uint8_t *)
-       FntSort(&(buffer->ot[z]), ctx->next_packet, x, y, text);
-
-   assert(ctx->next_packet <= &(buffer->buffer[BUFFER_LENGTH]));
-}
-
 /* Pong Game Structures and Constants */
 
 #define SCREEN_XRES 320
@@ -127,6 +38,24 @@ void draw_text(RenderContext *ctx, int x, int y, int z, const char *text)
 #define INITIAL_BALL_SPEED 2
 #define PADDLE_MARGIN 10
 
+// Scanline after vblank the SIO0 pad driver polls at (sio_pad.c). Build with
+// -DPAD_POLL_LINE=PAD_POLL_BIOS to keep the BIOS driver and compare the cost
+// printed at boot, or with -DPAD_POLL_LINE=PAD_POLL_ON_DEMAND to poll right
+// before the first tick of each frame (enable_late_pad_poll()) and compare
+// the input latency (SELECT + R2 to start and stop measuring).
+#define PAD_POLL_BIOS -2
+#ifndef PAD_POLL_LINE
+#define PAD_POLL_LINE 0
+#endif
+#define PAD_COST_FRAMES 8
+
+// Build with -DINPUT_PLAYBACK_AT_BOOT=1 to play back a recording left on the
+// memory card (SELECT + L2) instead of reading the pads, for reproducible
+// runs. Off by default: a stale recording would otherwise take over the game.
+#ifndef INPUT_PLAYBACK_AT_BOOT
+#define INPUT_PLAYBACK_AT_BOOT 0
+#endif
+
 typedef struct
 {
    int x, y;
@@ -147,6 +76,14 @@ typedef enum
    GAME_OVER
 } GameState;
 
+typedef struct
+{
+   GameState state;
+   Ball ball;
+   Paddle left_paddle;
+   Paddle right_paddle;
+} Game;
+
 void reset_ball(Ball *ball)
 {
    ball->x = SCREEN_XRES / 2 - BALL_SIZE / 2;
@@ -218,271 +155,531 @@ int check_scoring(Ball *ball, Paddle *left_paddle, Paddle *right_paddle)
 
 void draw_paddle(RenderContext *ctx, int x, int y)
 {
-   TILE *tile = (TILE *)new_primitive(ctx, 1, sizeof(TILE));
-   setTile(tile);
+   static const TILE paddle_template = TILE_TEMPLATE(PADDLE_WIDTH, PADDLE_HEIGHT, 255, 255, 255);
+
+   TILE *tile = (TILE *)new_primitive_from(ctx, 0, &paddle_template, sizeof(TILE));
    setXY0(tile, x, y);
-   setWH(tile, PADDLE_WIDTH, PADDLE_HEIGHT);
-   setRGB0(tile, 255, 255, 255);
+   mark_dirty(ctx, x, y, PADDLE_WIDTH, PADDLE_HEIGHT);
 }
 
-// Replace the existing draw_ball function with this:
-void draw_ball(RenderContext *ctx, Ball *ball, TIM_IMAGE *tim_ball)
+// Text whose content can change from frame to frame. Glyphs have transparent
+// pixels, so the area is marked for clearing in dirty rectangle mode.
+void draw_changing_text(RenderContext *ctx, int x, int y, const char *text)
 {
-    SPRT_16 *sprt = (SPRT_16 *)new_primitive(ctx, 1, sizeof(SPRT_16));
-    
-    // Initialize sprite properties
-    setSprt16(sprt);
-    setXY0(sprt, ball->x, ball->y);
-    setWH(sprt, BALL_SIZE, BALL_SIZE);
-    setRGB0(sprt, 128, 128, 128); // Neutral color (no tint)
-    
-    // Configure texture properties from TIM image
-    if (tim_ball->mode & 0x8) // Check if CLUT exists
-    {
-        setClut(sprt, tim_ball->crect->x, tim_ball->crect->y);
-    }
-    
-    // Set texture page and UV coordinates
-    setTPage(sprt, getTPage(tim_ball->mode & 0x3, 0, tim_ball->prect->x, tim_ball->prect->y));
-    setUV0(sprt, tim_ball->prect->x & 0xFF, tim_ball->prect->y & 0xFF);
+   draw_cached_text(ctx, x, y, 0, text);
+   mark_dirty(ctx, x, y, 8 * strlen(text), 8);
 }
 
-void draw_center_line(RenderContext *ctx)
+// Sprite textures, set up once the TIMs have been uploaded to VRAM
+enum
 {
+   TEXTURE_BALL,
+   TEXTURE_COUNT
+};
+
+static SpriteTexture sprite_textures[TEXTURE_COUNT];
+
+void draw_ball(RenderContext *ctx, const Ball *ball)
+{
+   SpriteInstance sprite = {ball->x, ball->y, TEXTURE_BALL};
+
+   draw_sprite_batch(ctx, 0, sprite_textures, TEXTURE_COUNT, &sprite, 1);
+   mark_dirty(ctx, ball->x, ball->y, sprite_textures[TEXTURE_BALL].width, sprite_textures[TEXTURE_BALL].height);
+}
+
+void build_center_line(StaticDisplayList *list)
+{
+   static const TILE dash_template = TILE_TEMPLATE(2, 8, 128, 128, 128);
+
    for (int y = 0; y < SCREEN_YRES; y += 16)
    {
-      TILE *tile = (TILE *)new_primitive(ctx, 0, sizeof(TILE));
-      setTile(tile);
+      TILE *tile = (TILE *)static_list_primitive(list, sizeof(TILE));
+      apply_template(tile, &dash_template, sizeof(TILE));
       setXY0(tile, SCREEN_XRES / 2 - 1, y);
-      setWH(tile, 2, 8);
-      setRGB0(tile, 128, 128, 128);
    }
+   finalize_static_list(list);
 }
 
-bool load_texture_to_context(RenderContext *ctx, TIM_IMAGE *image, u_long tim_data[])
-{
+// Static screen content, built once and linked into the OT every frame
+static uint32_t center_line_memory[STATIC_LIST_WORDS(15 * sizeof(TILE))];
+static uint32_t menu_text_memory[STATIC_LIST_WORDS(1600)];
+static uint32_t pause_text_memory[STATIC_LIST_WORDS(400)];
+static uint32_t game_over_text_memory[STATIC_LIST_WORDS(512)];
 
-   GetTimInfo(tim_data, image); /* Get TIM parameters */
+static StaticDisplayList center_line_list;
+static StaticDisplayList menu_text_list;
+static StaticDisplayList pause_text_list;
+static StaticDisplayList game_over_text_list;
 
-   LoadImage(image->prect, image->paddr); /* Upload texture to VRAM */
-   if (image->mode & 0x8)
-   {
-      LoadImage(image->crect, image->caddr); /* Upload CLUT if present */
-   }
+// Draw layers, back to front. Each has a small sub-OT of its own.
+#define LAYER_OT_LENGTH 4
 
-   return true;
+static uint32_t background_layer_memory[OT_LAYER_WORDS(LAYER_OT_LENGTH)];
+static uint32_t playfield_layer_memory[OT_LAYER_WORDS(LAYER_OT_LENGTH)];
+static uint32_t hud_layer_memory[OT_LAYER_WORDS(LAYER_OT_LENGTH)];
+
+static OtLayer background_layer;
+static OtLayer playfield_layer;
+static OtLayer hud_layer;
+static LayerStack layers;
+
+void init_layers(void)
+{
+   init_layer(&background_layer, "background", background_layer_memory, LAYER_OT_LENGTH);
+   init_layer(&playfield_layer, "playfield", playfield_layer_memory, LAYER_OT_LENGTH);
+   init_layer(&hud_layer, "hud", hud_layer_memory, LAYER_OT_LENGTH);
+
+   init_layer_stack(&layers);
+   add_layer(&layers, &background_layer);
+   add_layer(&layers, &playfield_layer);
+   add_layer(&layers, &hud_layer);
 }
 
-TIM_IMAGE tim_ball_image; // Declared globally or in main scope
+void build_static_lists(void)
+{
+   init_static_list(&center_line_list, center_line_memory, sizeof(center_line_memory) / 4);
+   build_center_line(&center_line_list);
+
+   init_static_list(&menu_text_list, menu_text_memory, sizeof(menu_text_memory) / 4);
+   static_list_text(&menu_text_list, SCREEN_XRES / 2 - 32, SCREEN_YRES / 2 - 40, "PONG");
+   static_list_text(&menu_text_list, SCREEN_XRES / 2 - 80, SCREEN_YRES / 2 - 16, "PRESS X TO START");
+   static_list_text(&menu_text_list, SCREEN_XRES / 2 - 120, SCREEN_YRES / 2 + 8, "PLAYER 1: LEFT PADDLE (PAD 1)");
+   static_list_text(&menu_text_list, SCREEN_XRES / 2 - 120, SCREEN_YRES / 2 + 24, "PLAYER 2: RIGHT PADDLE (PAD 2)");
+   static_list_text(&menu_text_list, SCREEN_XRES / 2 - 80, SCREEN_YRES / 2 + 48, "USE D-PAD UP/DOWN");
+   finalize_static_list(&menu_text_list);
+
+   init_static_list(&pause_text_list, pause_text_memory, sizeof(pause_text_memory) / 4);
+   static_list_text(&pause_text_list, SCREEN_XRES / 2 - 24, SCREEN_YRES / 2, "PAUSED");
+   static_list_text(&pause_text_list, SCREEN_XRES / 2 - 64, SCREEN_YRES / 2 + 16, "TRIANGLE TO RESUME");
+   finalize_static_list(&pause_text_list);
+
+   init_static_list(&game_over_text_list, game_over_text_memory, sizeof(game_over_text_memory) / 4);
+   static_list_text(&game_over_text_list, SCREEN_XRES / 2 - 32, SCREEN_YRES / 2 - 16, "GAME OVER");
+   static_list_text(&game_over_text_list, SCREEN_XRES / 2 - 72, SCREEN_YRES / 2 + 24, "PRESS X TO PLAY AGAIN");
+   finalize_static_list(&game_over_text_list);
+}
 
-int main(int argc, const char **argv)
+// VRAM layout: framebuffers (up to three 320x240 ones, see
+// initialize_render_context()), the debug font at (960, 0) with its CLUT at
+// (960, 128), and CLUTs in the unused rows below the framebuffers. Textures
+// are placed around them.
+static const RECT framebuffer_area = {0, 0, 640, 480};
+static const RECT font_area = {960, 0, 32, 48};
+static const RECT font_clut_area = {960, 128, 16, 1};
+static const RECT clut_area = {0, 480, 640, 32};
+
+static VramAllocator vram;
+
+void init_vram(void)
 {
-   // Initialize the GPU and load the default font texture provided by PSn00bSDK at (960, 0) in VRAM.
-   ResetGraph(0);
-   FntLoad(960, 0);
+   init_vram_allocator(&vram, &clut_area);
+   vram_reserve(&vram, &framebuffer_area);
+   vram_reserve(&vram, &font_area);
+   vram_reserve(&vram, &font_clut_area);
+}
 
-   // Set up our rendering context.
-   RenderContext ctx;
-   initialize_render_context(&ctx, SCREEN_XRES, SCREEN_YRES, 0, 0, 60); // Dark blue background
+// Stick to paddle speed, with the dead zone and curve precomputed
+static AnalogResponse analog_response;
 
-   if (!load_texture_to_context(&ctx, &tim_ball_image, tim_ball16c))
+// Files read from the disc (see iso.xml), each with its own buffer
+static AssetLoader assets;
+static uint32_t ball_tim[ASSET_BALL16C_BUFFER_SIZE / 4];
+static VramHandle ball_handle = VRAM_INVALID_HANDLE;
+static bool ball_loaded = false;
+
+// Unpacking throughput, measured in hblanks
+void print_asset_stats(const AssetLoader *loader)
+{
+   const AssetLoaderStats *stats = &(loader->stats);
+   uint32_t lines_per_second = platform_is_pal() ? 15625 : 15734;
+
+   printf("Assets: %u bytes read, %u unpacked in %u lines", (unsigned)stats->bytes_read,
+          (unsigned)stats->bytes_unpacked, (unsigned)stats->unpack_lines);
+   if (stats->unpack_lines)
    {
-      printf("Failed to upload texture.\n");
-      return 1;
+      printf(" (%u KB/s)", (unsigned)((stats->bytes_unpacked / stats->unpack_lines) * lines_per_second / 1024));
    }
+   printf("\n");
+}
 
-   // Initialize game pads for both players
-   GamePad pad1 = init_game_pad(0); // Player 1 (left paddle)
-   GamePad pad2 = init_game_pad(1); // Player 2 (right paddle)
+void on_ball_loaded(const uint32_t *data, size_t size, void *user)
+{
+   VramHandle handle = data ? vram_load_tim(&vram, data) : VRAM_INVALID_HANDLE;
 
-   // Game state
-   GameState state = GAME_MENU;
-   Ball ball;
+   (void)size;
+   (void)user;
 
-   Paddle left_paddle = {SCREEN_YRES / 2 - PADDLE_HEIGHT / 2, 0};
-   Paddle right_paddle = {SCREEN_YRES / 2 - PADDLE_HEIGHT / 2, 0};
+   if (handle == VRAM_INVALID_HANDLE)
+   {
+      printf("Failed to load the ball texture.\n");
+      return;
+   }
 
-   reset_ball(&ball);
+   init_sprite_texture(&sprite_textures[TEXTURE_BALL], vram_image(&vram, handle), 16, 16);
+   ball_handle = handle;
+   ball_loaded = true;
+   print_asset_stats(&assets);
+}
 
-   SPRT_16 *sprt;
+void toggle_pause(Game *game)
+{
+   if (game->state == GAME_PLAYING)
+   {
+      game->state = GAME_PAUSED;
+   }
+   else if (game->state == GAME_PAUSED)
+   {
+      game->state = GAME_PLAYING;
+   }
+}
 
-   for (;;)
+// Recordings only hold what sync_all_pads() sees (see input_record.c), so
+// while one is recorded or played back the pause follows the synced presses
+// of each tick instead of the events.
+bool pause_from_synced_input(void)
+{
+   return input_record_is_active() || input_playback_is_active();
+}
+
+// Consumes the presses recorded by the pad capture. Pausing works from the
+// events rather than the sampled state so that a tap shorter than a frame
+// toggles it exactly once.
+void handle_pad_events(Game *game)
+{
+   PadEvent event;
+
+   while (poll_pad_event(&event))
    {
-      // Sync pad states
-      sync_pad(&pad1);
-      sync_pad(&pad2);
+      if ((event.pressed & PAD_BUTTON_TRIANGLE) && !pause_from_synced_input())
+      {
+         toggle_pause(game);
+      }
+   }
+}
+
+// One fixed-rate tick of game logic
+void update_game(Game *game, GamePad *pad1, GamePad *pad2)
+{
+   Ball *ball = &game->ball;
+   Paddle *left_paddle = &game->left_paddle;
+   Paddle *right_paddle = &game->right_paddle;
 
-      char text_buffer[256];
+   switch (game->state)
+   {
+   case GAME_MENU:
+      // The game can't start before its textures are in
+      if (PAD_JUST_RELEASED(pad1, PAD_BUTTON_CIRCLE) && ball_loaded)
+      {
+         game->state = GAME_PLAYING;
+         left_paddle->score = 0;
+         right_paddle->score = 0;
+         reset_ball(ball);
+      }
+      break;
 
-      switch (state)
+   case GAME_PLAYING:
+      if (PAD_IS_CONNECTED(pad1))
       {
-      case GAME_MENU:
-         draw_text(&ctx, SCREEN_XRES / 2 - 32, SCREEN_YRES / 2 - 40, 0, "PONG");
-         draw_text(&ctx, SCREEN_XRES / 2 - 80, SCREEN_YRES / 2 - 16, 0, "PRESS X TO START");
-         draw_text(&ctx, SCREEN_XRES / 2 - 120, SCREEN_YRES / 2 + 8, 0, "PLAYER 1: LEFT PADDLE (PAD 1)");
-         draw_text(&ctx, SCREEN_XRES / 2 - 120, SCREEN_YRES / 2 + 24, 0, "PLAYER 2: RIGHT PADDLE (PAD 2)");
-         draw_text(&ctx, SCREEN_XRES / 2 - 80, SCREEN_YRES / 2 + 48, 0, "USE D-PAD UP/DOWN");
-
-         if (is_button_just_released(&pad1, PAD_BUTTON_CIRCLE))
+         if (PAD_HELD(pad1, PAD_BUTTON_UP) && left_paddle->y > 0)
          {
-            state = GAME_PLAYING;
-            left_paddle.score = 0;
-            right_paddle.score = 0;
-            reset_ball(&ball);
+            left_paddle->y -= PADDLE_SPEED;
+         }
+         if (PAD_HELD(pad1, PAD_BUTTON_DOWN) && left_paddle->y < SCREEN_YRES - PADDLE_HEIGHT)
+         {
+            left_paddle->y += PADDLE_SPEED;
          }
 
-         break;
-
-      case GAME_PLAYING:
-
-         if (pad1.connected)
+         // Handle analog stick for player 1
+         if (is_analog_available(pad1))
          {
-            if (pad1.dpad.up && left_paddle.y > 0)
-            {
-               left_paddle.y -= PADDLE_SPEED;
-            }
-            if (pad1.dpad.down && left_paddle.y < SCREEN_YRES - PADDLE_HEIGHT)
-            {
-               left_paddle.y += PADDLE_SPEED;
-            }
-
-            // Handle analog stick for player 1
-            if (is_analog_available(&pad1))
-            {
-               float analog_y = get_analog_y_normalized(&pad1, true);
-               left_paddle.y += (int)(analog_y * PADDLE_SPEED);
-            }
+            left_paddle->y += get_analog_y_delta(pad1, true, &analog_response, PADDLE_SPEED);
          }
-         else
+      }
+      else
+      {
+         // AI for left paddle if no controller
+         int ball_center = ball->y + BALL_SIZE / 2;
+         int paddle_center = left_paddle->y + PADDLE_HEIGHT / 2;
+         if (ball_center < paddle_center - 10)
          {
-            // AI for left paddle if no controller
-            int ball_center = ball.y + BALL_SIZE / 2;
-            int paddle_center = left_paddle.y + PADDLE_HEIGHT / 2;
-            if (ball_center < paddle_center - 10)
-            {
-               left_paddle.y -= PADDLE_SPEED - 2;
-            }
-            else if (ball_center > paddle_center + 10)
-            {
-               left_paddle.y += PADDLE_SPEED - 2;
-            }
+            left_paddle->y -= PADDLE_SPEED - 2;
          }
+         else if (ball_center > paddle_center + 10)
+         {
+            left_paddle->y += PADDLE_SPEED - 2;
+         }
+      }
 
-         // Player 2 (right paddle) controls
-         if (pad2.connected)
+      // Player 2 (right paddle) controls
+      if (PAD_IS_CONNECTED(pad2))
+      {
+         if (PAD_HELD(pad2, PAD_BUTTON_UP) && right_paddle->y > 0)
          {
-            if (pad2.dpad.up && right_paddle.y > 0)
-            {
-               right_paddle.y -= PADDLE_SPEED;
-            }
-            if (pad2.dpad.down && right_paddle.y < SCREEN_YRES - PADDLE_HEIGHT)
-            {
-               right_paddle.y += PADDLE_SPEED;
-            }
-
-            // Handle analog stick for player 2
-            if (is_analog_available(&pad2))
-            {
-               float analog_y = get_analog_y_normalized(&pad2, true);
-               right_paddle.y += (int)(analog_y * PADDLE_SPEED);
-            }
+            right_paddle->y -= PADDLE_SPEED;
          }
-         else
+         if (PAD_HELD(pad2, PAD_BUTTON_DOWN) && right_paddle->y < SCREEN_YRES - PADDLE_HEIGHT)
          {
-            // AI for right paddle if no controller
-            int ball_center = ball.y + BALL_SIZE / 2;
-            int paddle_center = right_paddle.y + PADDLE_HEIGHT / 2;
-            if (ball_center < paddle_center - 10)
-            {
-               right_paddle.y -= PADDLE_SPEED - 1;
-            }
-            else if (ball_center > paddle_center + 10)
-            {
-               right_paddle.y += PADDLE_SPEED - 1;
-            }
+            right_paddle->y += PADDLE_SPEED;
          }
 
-         // Keep paddles in bounds
-         if (left_paddle.y < 0)
-            left_paddle.y = 0;
-         if (left_paddle.y > SCREEN_YRES - PADDLE_HEIGHT)
-            left_paddle.y = SCREEN_YRES - PADDLE_HEIGHT;
-         if (right_paddle.y < 0)
-            right_paddle.y = 0;
-         if (right_paddle.y > SCREEN_YRES - PADDLE_HEIGHT)
-            right_paddle.y = SCREEN_YRES - PADDLE_HEIGHT;
-
-         // Update ball
-         update_ball(&ball, &left_paddle, &right_paddle);
-
-         // Check for scoring
-         int scored = check_scoring(&ball, &left_paddle, &right_paddle);
-         if (scored)
+         // Handle analog stick for player 2
+         if (is_analog_available(pad2))
+         {
+            right_paddle->y += get_analog_y_delta(pad2, true, &analog_response, PADDLE_SPEED);
+         }
+      }
+      else
+      {
+         // AI for right paddle if no controller
+         int ball_center = ball->y + BALL_SIZE / 2;
+         int paddle_center = right_paddle->y + PADDLE_HEIGHT / 2;
+         if (ball_center < paddle_center - 10)
+         {
+            right_paddle->y -= PADDLE_SPEED - 1;
+         }
+         else if (ball_center > paddle_center + 10)
          {
-            reset_ball(&ball);
-            if (left_paddle.score >= 5 || right_paddle.score >= 5)
-            {
-               state = GAME_OVER;
-            }
+            right_paddle->y += PADDLE_SPEED - 1;
          }
+      }
 
-         // Pause functionality
-         if ((pad1.connected && pad1.face.triangle) || (pad2.connected && pad2.face.triangle))
+      // Keep paddles in bounds
+      if (left_paddle->y < 0)
+         left_paddle->y = 0;
+      if (left_paddle->y > SCREEN_YRES - PADDLE_HEIGHT)
+         left_paddle->y = SCREEN_YRES - PADDLE_HEIGHT;
+      if (right_paddle->y < 0)
+         right_paddle->y = 0;
+      if (right_paddle->y > SCREEN_YRES - PADDLE_HEIGHT)
+         right_paddle->y = SCREEN_YRES - PADDLE_HEIGHT;
+
+      // Update ball
+      update_ball(ball, left_paddle, right_paddle);
+
+      // Check for scoring
+      if (check_scoring(ball, left_paddle, right_paddle))
+      {
+         reset_ball(ball);
+         if (left_paddle->score >= 5 || right_paddle->score >= 5)
          {
-            state = GAME_PAUSED;
+            game->state = GAME_OVER;
          }
+      }
+      break;
+
+   case GAME_PAUSED:
+      // Pausing and resuming happen in handle_pad_events()
+      break;
+
+   case GAME_OVER:
+      // Disconnected pads report no buttons
+      if (PAD_HELD(pad1, PAD_BUTTON_X) || PAD_HELD(pad2, PAD_BUTTON_X))
+      {
+         game->state = GAME_MENU;
+      }
+      break;
+   }
+}
+
+// Draws the current state, once per frame however many ticks ran
+void draw_game(RenderContext *ctx, const Game *game, const GamePad *pad1, const GamePad *pad2)
+{
+   char text_buffer[FORMAT_BUFFER_SIZE];
+
+   switch (game->state)
+   {
+   case GAME_MENU:
+      begin_layer(ctx, &hud_layer);
+      link_static_list(ctx, &menu_text_list, 0);
+      end_layer(ctx);
+      break;
+
+   case GAME_PLAYING:
+      begin_layer(ctx, &background_layer);
+      link_static_list(ctx, &center_line_list, 0);
+      end_layer(ctx);
+
+      begin_layer(ctx, &playfield_layer);
+      draw_paddle(ctx, PADDLE_MARGIN, game->left_paddle.y);
+      draw_paddle(ctx, SCREEN_XRES - PADDLE_WIDTH - PADDLE_MARGIN, game->right_paddle.y);
+      draw_ball(ctx, &game->ball);
+      end_layer(ctx);
+
+      begin_layer(ctx, &hud_layer);
+
+      // Draw scores
+      format_int(text_buffer, game->left_paddle.score);
+      draw_changing_text(ctx, SCREEN_XRES / 2 - 40, 20, text_buffer);
+      format_int(text_buffer, game->right_paddle.score);
+      draw_changing_text(ctx, SCREEN_XRES / 2 + 32, 20, text_buffer);
+
+      // Draw controller status
+      draw_changing_text(ctx, 8, SCREEN_YRES - 16, PAD_IS_CONNECTED(pad1) ? "P1: OK" : "P1: AI");
+      draw_changing_text(ctx, SCREEN_XRES - 48, SCREEN_YRES - 16, PAD_IS_CONNECTED(pad2) ? "P2: OK" : "P2: AI");
+      end_layer(ctx);
+      break;
+
+   case GAME_PAUSED:
+      begin_layer(ctx, &hud_layer);
+      link_static_list(ctx, &pause_text_list, 0);
+      end_layer(ctx);
+      break;
+
+   case GAME_OVER:
+      begin_layer(ctx, &hud_layer);
+      link_static_list(ctx, &game_over_text_list, 0);
+      if (game->left_paddle.score >= 5)
+      {
+         draw_cached_text(ctx, SCREEN_XRES / 2 - 48, SCREEN_YRES / 2, 0, "PLAYER 1 WINS!");
+      }
+      else
+      {
+         draw_cached_text(ctx, SCREEN_XRES / 2 - 48, SCREEN_YRES / 2, 0, "PLAYER 2 WINS!");
+      }
+      end_layer(ctx);
+      break;
+   }
+}
 
-         // Draw game elements
-         draw_center_line(&ctx);
-         draw_paddle(&ctx, PADDLE_MARGIN, left_paddle.y);
-         draw_paddle(&ctx, SCREEN_XRES - PADDLE_WIDTH - PADDLE_MARGIN, right_paddle.y);
-         draw_ball(&ctx, &ball, &tim_ball_image);
+int main(int argc, const char **argv)
+{
+   // Initialize the GPU and load the default font texture provided by PSn00bSDK at (960, 0) in VRAM.
+   platform_init_graphics();
+   platform_load_font(960, 0);
+
+   // Set up our rendering context. Its OTs and packet buffers live in static
+   // RAM, and the context itself is static too as the pipeline callbacks keep
+   // referencing it.
+   static const RenderConfig render_config = DEFAULT_RENDER_CONFIG;
+   static uint32_t render_memory[RENDER_MEMORY_WORDS(OT_LENGTH, BUFFER_LENGTH, SPILL_BUFFER_LENGTH, MAX_RENDER_BUFFERS)];
+   static RenderContext ctx;
+   initialize_render_context(&ctx, &render_config, render_memory,
+                             SCREEN_XRES, SCREEN_YRES, 0, 0, 60); // Dark blue background
+
+   // Let the CPU build the next frame while the GPU draws the current one, with
+   // a third buffer to absorb frames that run long.
+   enable_render_pipeline(&ctx, 3);
+
+   // Only clear what moved instead of the whole screen, unless more than a
+   // quarter of it did.
+   enable_dirty_rects(&ctx, SCREEN_XRES * SCREEN_YRES / 4);
+
+   // Both rely on FntSort(), which needs the font loaded by FntLoad().
+   build_static_lists();
+   init_text_cache();
+   init_layers();
+
+   // Textures stream in from the disc while the menu is up
+   init_vram();
+   platform_init_cd();
+   init_asset_loader(&assets);
+   request_packed_asset(&assets, ASSET_BALL16C, ball_tim, sizeof(ball_tim), on_ball_loaded, NULL);
+
+   // Our own pad driver instead of the BIOS one, polling when we say
+   if (PAD_POLL_LINE != PAD_POLL_BIOS)
+   {
+      platform_use_sio_pad_driver(PAD_POLL_LINE);
+   }
 
-         // Draw scores
-         sprintf(text_buffer, "%d", left_paddle.score);
-         draw_text(&ctx, SCREEN_XRES / 2 - 40, 20, 0, text_buffer);
-         sprintf(text_buffer, "%d", right_paddle.score);
-         draw_text(&ctx, SCREEN_XRES / 2 + 32, 20, 0, text_buffer);
+   // Every pad slot, multitaps included (with the SIO driver), is synced in
+   // one pass. Players use the first connector of each port.
+   static PadManager pads;
+   init_pad_manager(&pads);
+   printf("Pads: %s driver takes %u us per frame\n", PAD_POLL_LINE != PAD_POLL_BIOS ? "SIO" : "BIOS",
+          (unsigned)platform_measure_pad_cost(PAD_COST_FRAMES));
+   GamePad *pad1 = get_game_pad(&pads, PAD_SLOT(0, 0)); // Player 1 (left paddle)
+   GamePad *pad2 = get_game_pad(&pads, PAD_SLOT(1, 0)); // Player 2 (right paddle)
+
+   // Sample the pads from the vsync interrupt, after the render pipeline has
+   // installed its own callback.
+   enable_pad_capture();
+   if (PAD_POLL_LINE == PAD_POLL_ON_DEMAND)
+   {
+      enable_late_pad_poll();
+   }
+   init_analog_response(&analog_response, DEFAULT_ANALOG_DEAD_ZONE, DEFAULT_ANALOG_OUTER_ZONE,
+                        DEFAULT_ANALOG_CURVE, true);
 
-         // Draw controller status
-         draw_text(&ctx, 8, SCREEN_YRES - 16, 0, pad1.connected ? "P1: OK" : "P1: AI");
-         draw_text(&ctx, SCREEN_XRES - 48, SCREEN_YRES - 16, 0, pad2.connected ? "P2: OK" : "P2: AI");
-         break;
+   if (INPUT_PLAYBACK_AT_BOOT)
+   {
+      input_playback_start(INPUT_RECORD_FILE);
+   }
 
-      case GAME_PAUSED:
-         draw_text(&ctx, SCREEN_XRES / 2 - 24, SCREEN_YRES / 2, 0, "PAUSED");
-         draw_text(&ctx, SCREEN_XRES / 2 - 64, SCREEN_YRES / 2 + 16, 0, "TRIANGLE TO RESUME");
+   // Game state
+   Game game = {GAME_MENU};
+   GameState drawn_state = GAME_MENU;
 
-         if ((pad1.connected && pad1.face.triangle) || (pad2.connected && pad2.face.triangle))
-         {
-            state = GAME_PLAYING;
-         }
-         break;
+   game.left_paddle.y = SCREEN_YRES / 2 - PADDLE_HEIGHT / 2;
+   game.right_paddle.y = SCREEN_YRES / 2 - PADDLE_HEIGHT / 2;
+   reset_ball(&game.ball);
 
-      case GAME_OVER:
-         draw_text(&ctx, SCREEN_XRES / 2 - 32, SCREEN_YRES / 2 - 16, 0, "GAME OVER");
-         if (left_paddle.score >= 5)
-         {
-            draw_text(&ctx, SCREEN_XRES / 2 - 48, SCREEN_YRES / 2, 0, "PLAYER 1 WINS!");
-         }
-         else
-         {
-            draw_text(&ctx, SCREEN_XRES / 2 - 48, SCREEN_YRES / 2, 0, "PLAYER 2 WINS!");
-         }
-         draw_text(&ctx, SCREEN_XRES / 2 - 72, SCREEN_YRES / 2 + 24, 0, "PRESS X TO PLAY AGAIN");
+   // The game logic runs at a fixed rate whatever the video standard and the
+   // frame rate, see frame_clock.c.
+   FrameClock clock;
+   init_frame_clock(&clock, DEFAULT_TICK_RATE, DEFAULT_MAX_TICKS);
+
+   profiler_init();
+
+   for (;;)
+   {
+      profiler_begin_frame();
+      int ticks = frame_clock_begin(&clock);
+      profiler_mark(PROFILE_VSYNC);
+
+      update_asset_loader(&assets);
+      handle_pad_events(&game);
 
-         if ((pad1.connected && pad1.face.x) || (pad2.connected && pad2.face.x))
+      for (int i = 0; i < ticks; i++)
+      {
+         // Sync pad states
+         sync_all_pads(&pads);
+         profiler_handle_input(pad1);
+         gpu_trace_handle_input(pad1);
+         input_record_handle_input(pad1);
+         input_latency_handle_input(pad1);
+
+         // The capture's edges make a tap shorter than a tick count here too
+         if (pause_from_synced_input() &&
+             (PAD_JUST_PRESSED(pad1, PAD_BUTTON_TRIANGLE) || PAD_JUST_PRESSED(pad2, PAD_BUTTON_TRIANGLE)))
          {
-            state = GAME_MENU;
+            toggle_pause(&game);
          }
-         break;
+
+         update_game(&game, pad1, pad2);
+      }
+      profiler_mark(PROFILE_UPDATE);
+
+      // Each state has its own static content, which dirty rectangles don't
+      // track.
+      if (game.state != drawn_state)
+      {
+         invalidate_screen(&ctx);
+         drawn_state = game.state;
+      }
+
+      // Textures used this frame stay in VRAM until the GPU is done with it
+      vram_set_frames(&vram, ctx.frame_number, ctx.drawn_frame);
+      if (ball_loaded)
+      {
+         vram_touch(&vram, ball_handle);
+      }
+
+      draw_game(&ctx, &game, pad1, pad2);
+
+      if (profiler_is_visible())
+      {
+         begin_layer(&ctx, &hud_layer);
+         profiler_draw(&ctx, 8, SCREEN_YRES - 24);
+         end_layer(&ctx);
       }
+      link_layers(&ctx, &layers, 0);
+      profiler_mark(PROFILE_BUILD);
 
       flip_buffers(&ctx);
+      profiler_end_frame();
    }
 
    // Cleanup (though this won't be reached in this example)
-   cleanup_game_pad(&pad1);
-   cleanup_game_pad(&pad2);
+   cleanup_pad_manager(&pads);
    return 0;
 }
\ No newline at end of file
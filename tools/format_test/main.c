@@ -0,0 +1,211 @@
+/**
+ * @file main.c
+ * @brief Host checks and benchmark for src/libs/format.c
+ *
+ * Usage:
+ *   format_test [iterations]
+ *       Compares every formatter with what sprintf() prints for the same
+ *       value (edge cases like INT32_MIN, padding of zero and negative values,
+ *       fixed point fractions and out of range widths and digit counts, then
+ *       a sweep of pseudo-random values), and exits with status 1 on the
+ *       first mismatch. Then times the formatters against sprintf() over the
+ *       given number of iterations.
+ *
+ * fixed_t fractions have at most FIXED_BITS binary digits, so their decimal
+ * expansion is exact in a double and format_fixed()'s truncated output is
+ * taken from "%.12f" cut after the requested decimals. Build and run with
+ * `make format-test`.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../src/libs/format.h"
+
+#define DEFAULT_ITERATIONS 1000000
+#define RANDOM_VALUES 200000
+
+static int failures = 0;
+
+static void check(const char *what, int32_t value, int argument, const char *got, int length,
+                  const char *expected)
+{
+   if (strcmp(got, expected) || length != (int)strlen(expected))
+   {
+      fprintf(stderr, "format_test: %s(%d, %d) gave \"%s\" (%d), expected \"%s\"\n", what, (int)value,
+              argument, got, length, expected);
+      failures++;
+   }
+}
+
+static void check_int(int32_t value)
+{
+   char got[FORMAT_BUFFER_SIZE];
+   char expected[64];
+
+   sprintf(expected, "%d", (int)value);
+   check("format_int", value, 0, got, format_int(got, value), expected);
+
+   sprintf(expected, "%u", (unsigned)value);
+   check("format_uint", value, 0, got, format_uint(got, (uint32_t)value), expected);
+}
+
+static void check_padded(int32_t value, int width)
+{
+   char got[FORMAT_BUFFER_SIZE];
+   char expected[64];
+   int clamped = width > FORMAT_MAX_WIDTH ? FORMAT_MAX_WIDTH : width;
+
+   sprintf(expected, "%0*d", clamped, (int)value);
+   check("format_int_padded", value, width, got, format_int_padded(got, value, width), expected);
+}
+
+static void check_hex(uint32_t value, int digits)
+{
+   char got[FORMAT_BUFFER_SIZE];
+   char expected[64];
+   int clamped = digits < 1 ? 1 : digits > FORMAT_MAX_HEX_DIGITS ? FORMAT_MAX_HEX_DIGITS : digits;
+
+   sprintf(expected, "%08X", (unsigned)value);
+   check("format_hex", (int32_t)value, digits, got, format_hex(got, value, digits), &expected[8 - clamped]);
+}
+
+static void check_fixed(fixed_t value, int decimals)
+{
+   char got[FORMAT_BUFFER_SIZE];
+   char expected[64];
+   int clamped = decimals > FORMAT_MAX_DECIMALS ? FORMAT_MAX_DECIMALS : decimals < 0 ? 0 : decimals;
+
+   sprintf(expected, "%.12f", value / (double)FIXED_ONE);
+
+   // Cut after the wanted decimals, dropping the point with none
+   char *point = strchr(expected, '.');
+   point[clamped ? clamped + 1 : 0] = 0;
+
+   check("format_fixed", value, decimals, got, format_fixed(got, value, decimals), expected);
+}
+
+static void run_checks(void)
+{
+   static const int32_t edges[] = {0, 1, -1, 9, 10, -10, 99, 100, 12345, -12345, 999999999, 1000000000,
+                                   INT32_MAX, INT32_MIN, INT32_MIN + 1};
+   static const int widths[] = {0, 1, 2, 3, 5, 10, 11, 12, FORMAT_MAX_WIDTH, FORMAT_MAX_WIDTH + 1, 100};
+   static const fixed_t fractions[] = {0, 1, -1, FIXED_ONE, -FIXED_ONE, FIXED_ONE / 2, -FIXED_ONE / 2,
+                                       FIXED_ONE / 3, FIXED_ONE - 1, -(FIXED_ONE - 1), FIXED_MASK,
+                                       123 * FIXED_ONE + 7, INT32_MAX, INT32_MIN, INT32_MIN + 1};
+
+   for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+   {
+      check_int(edges[i]);
+      for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+      {
+         check_padded(edges[i], widths[w]);
+      }
+      for (int digits = -1; digits <= FORMAT_MAX_HEX_DIGITS + 2; digits++)
+      {
+         check_hex((uint32_t)edges[i], digits);
+      }
+   }
+
+   for (size_t i = 0; i < sizeof(fractions) / sizeof(fractions[0]); i++)
+   {
+      for (int decimals = -1; decimals <= FORMAT_MAX_DECIMALS + 12; decimals++)
+      {
+         check_fixed(fractions[i], decimals);
+      }
+   }
+
+   // Fixed seed so a failure can be reproduced
+   srand(1);
+   for (int i = 0; i < RANDOM_VALUES && !failures; i++)
+   {
+      int32_t value = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+
+      check_int(value);
+      check_padded(value, i % 16);
+      check_hex((uint32_t)value, 1 + i % 8);
+      check_fixed(value, i % 9);
+   }
+}
+
+static double seconds_since(const struct timespec *start)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Prints ns per call of both; the sink keeps the calls from being dropped
+static void run_bench(int iterations)
+{
+   char buffer[64];
+   struct timespec start;
+   volatile int sink = 0;
+   double ours, theirs;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int i = 0; i < iterations; i++)
+   {
+      sink += format_int(buffer, i * 7919 - 50000000);
+   }
+   ours = seconds_since(&start);
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int i = 0; i < iterations; i++)
+   {
+      sink += sprintf(buffer, "%d", i * 7919 - 50000000);
+   }
+   theirs = seconds_since(&start);
+   printf("format_int:        %6.1f ns, sprintf %%d:   %6.1f ns\n", ours * 1e9 / iterations, theirs * 1e9 / iterations);
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int i = 0; i < iterations; i++)
+   {
+      sink += format_int_padded(buffer, i % 100000, 6);
+   }
+   ours = seconds_since(&start);
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int i = 0; i < iterations; i++)
+   {
+      sink += sprintf(buffer, "%06d", i % 100000);
+   }
+   theirs = seconds_since(&start);
+   printf("format_int_padded: %6.1f ns, sprintf %%06d: %6.1f ns\n", ours * 1e9 / iterations, theirs * 1e9 / iterations);
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int i = 0; i < iterations; i++)
+   {
+      sink += format_fixed(buffer, i * 13, 3);
+   }
+   ours = seconds_since(&start);
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int i = 0; i < iterations; i++)
+   {
+      sink += sprintf(buffer, "%.3f", (i * 13) / (double)FIXED_ONE);
+   }
+   theirs = seconds_since(&start);
+   printf("format_fixed:      %6.1f ns, sprintf %%.3f: %6.1f ns\n", ours * 1e9 / iterations, theirs * 1e9 / iterations);
+}
+
+int main(int argc, char **argv)
+{
+   int iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+
+   run_checks();
+   if (failures)
+   {
+      fprintf(stderr, "format_test: %d mismatches\n", failures);
+      return 1;
+   }
+   printf("format_test: all checks passed\n");
+
+   if (iterations > 0)
+   {
+      run_bench(iterations);
+   }
+
+   return 0;
+}
@@ -0,0 +1,396 @@
+/**
+ * @file main.c
+ * @brief Host tool for GPU traces captured by src/libs/gpu_trace.c
+ *
+ * Usage:
+ *   gpu_trace info <trace>
+ *       Per frame and OT slot: packet count, bytes and primitive mix
+ *   gpu_trace diff <before> <after>
+ *       Compares the frames of two traces slot by slot and reports what
+ *       changed; exits with status 1 if anything did
+ *   gpu_trace replay <trace> <out_dir> [vram.png]
+ *       Rasterizes every frame with the soft GPU into out_dir/frame_NNNNN.png.
+ *       Textures are not part of a trace, pass a full VRAM dump (vram_*.png
+ *       from the host build's HOST_DUMP_DIR) to draw sprites and text.
+ *
+ * Build with `make gpu-trace`.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../src/libs/host/soft_gpu.h"
+#include "../../src/libs/host/png_io.h"
+#include "../../src/libs/gpu_trace.h"
+
+#define MAX_SLOTS 256
+
+typedef enum {
+   KIND_FILL,
+   KIND_TILE,
+   KIND_SPRITE,
+   KIND_POLYGON,
+   KIND_LINE,
+   KIND_STATE,
+   KIND_OTHER,
+   KIND_COUNT
+} CommandKind;
+
+static const char *const kind_names[KIND_COUNT] = {
+    "fill", "tile", "sprite", "poly", "line", "state", "other"};
+
+typedef struct
+{
+   uint32_t packets;
+   uint32_t bytes;
+   uint32_t kinds[KIND_COUNT];
+} SlotSummary;
+
+typedef struct
+{
+   const GpuTraceHeader *header;
+   const uint32_t *words;
+} TraceFrame;
+
+typedef struct
+{
+   uint32_t *data;
+   size_t word_count;
+   TraceFrame *frames;
+   int frame_count;
+} Trace;
+
+static CommandKind classify(uint32_t code)
+{
+   if (code == 0x02)
+   {
+      return KIND_FILL;
+   }
+   if (code >= 0x20 && code < 0x40)
+   {
+      return KIND_POLYGON;
+   }
+   if (code >= 0x40 && code < 0x60)
+   {
+      return KIND_LINE;
+   }
+   if (code >= 0x60 && code < 0x80)
+   {
+      return (code & 0x04) ? KIND_SPRITE : KIND_TILE;
+   }
+   if (code >= 0xe1 && code <= 0xe6)
+   {
+      return KIND_STATE;
+   }
+
+   return KIND_OTHER;
+}
+
+static bool load_trace(const char *path, Trace *trace)
+{
+   FILE *file = fopen(path, "rb");
+
+   memset(trace, 0, sizeof(*trace));
+   if (!file)
+   {
+      fprintf(stderr, "gpu_trace: can't open %s\n", path);
+      return false;
+   }
+
+   fseek(file, 0, SEEK_END);
+   long size = ftell(file);
+   fseek(file, 0, SEEK_SET);
+
+   trace->data = malloc(size + 4);
+   trace->word_count = fread(trace->data, 1, size, file) / 4;
+   fclose(file);
+
+   // Index the frames
+   size_t offset = 0;
+   int capacity = 0;
+
+   while (offset + GPU_TRACE_HEADER_WORDS <= trace->word_count)
+   {
+      const GpuTraceHeader *header = (const GpuTraceHeader *)&trace->data[offset];
+
+      if (header->magic != GPU_TRACE_MAGIC ||
+          offset + GPU_TRACE_HEADER_WORDS + header->word_count > trace->word_count)
+      {
+         fprintf(stderr, "gpu_trace: %s: bad or truncated frame at byte %zu\n", path, offset * 4);
+         break;
+      }
+
+      if (trace->frame_count == capacity)
+      {
+         capacity = capacity ? capacity * 2 : 64;
+         trace->frames = realloc(trace->frames, capacity * sizeof(TraceFrame));
+      }
+
+      trace->frames[trace->frame_count].header = header;
+      trace->frames[trace->frame_count].words = &trace->data[offset + GPU_TRACE_HEADER_WORDS];
+      trace->frame_count++;
+
+      offset += GPU_TRACE_HEADER_WORDS + header->word_count;
+   }
+
+   return true;
+}
+
+static void free_trace(Trace *trace)
+{
+   free(trace->data);
+   free(trace->frames);
+}
+
+// Calls visit() for every packet of a frame
+static void for_each_packet(const TraceFrame *frame,
+                            void (*visit)(int slot, const uint32_t *words, int length, void *user),
+                            void *user)
+{
+   uint32_t index = 0;
+
+   while (index < frame->header->word_count)
+   {
+      uint32_t info = frame->words[index];
+      int length = GPU_TRACE_PACKET_LENGTH(info);
+
+      visit(GPU_TRACE_PACKET_SLOT(info), &frame->words[index + 1], length, user);
+      index += 1 + length;
+   }
+}
+
+static void summarize_packet(int slot, const uint32_t *words, int length, void *user)
+{
+   SlotSummary *slots = (SlotSummary *)user;
+   SlotSummary *summary = &slots[slot % MAX_SLOTS];
+   int index = 0;
+
+   summary->packets++;
+   summary->bytes += 4 + length * 4;
+
+   while (index < length)
+   {
+      int command_length = soft_gpu_command_length(&words[index], length - index);
+
+      summary->kinds[classify(words[index] >> 24)]++;
+      if (!command_length)
+      {
+         break;
+      }
+      index += command_length;
+   }
+}
+
+static void summarize_frame(const TraceFrame *frame, SlotSummary *slots)
+{
+   memset(slots, 0, sizeof(SlotSummary) * MAX_SLOTS);
+   for_each_packet(frame, summarize_packet, slots);
+}
+
+static void print_mix(const SlotSummary *summary)
+{
+   for (int k = 0; k < KIND_COUNT; k++)
+   {
+      if (summary->kinds[k])
+      {
+         printf(" %s:%u", kind_names[k], (unsigned)summary->kinds[k]);
+      }
+   }
+}
+
+static int command_info(const char *path)
+{
+   Trace trace;
+   SlotSummary slots[MAX_SLOTS];
+
+   if (!load_trace(path, &trace))
+   {
+      return 2;
+   }
+
+   for (int f = 0; f < trace.frame_count; f++)
+   {
+      const TraceFrame *frame = &trace.frames[f];
+      SlotSummary total = {0};
+
+      summarize_frame(frame, slots);
+
+      for (int s = 0; s < MAX_SLOTS; s++)
+      {
+         total.packets += slots[s].packets;
+         total.bytes += slots[s].bytes;
+         for (int k = 0; k < KIND_COUNT; k++)
+         {
+            total.kinds[k] += slots[s].kinds[k];
+         }
+      }
+
+      printf("frame %d (vblank %u): %u packets, %u bytes,", f, (unsigned)frame->header->frame,
+             (unsigned)total.packets, (unsigned)total.bytes);
+      print_mix(&total);
+      printf("\n");
+
+      for (int s = (int)frame->header->ot_length - 1; s >= 0; s--)
+      {
+         if (slots[s].packets)
+         {
+            printf("  slot %2d: %4u packets %6u bytes,", s, (unsigned)slots[s].packets, (unsigned)slots[s].bytes);
+            print_mix(&slots[s]);
+            printf("\n");
+         }
+      }
+   }
+
+   free_trace(&trace);
+   return 0;
+}
+
+static int command_diff(const char *before_path, const char *after_path)
+{
+   Trace before, after;
+   SlotSummary before_slots[MAX_SLOTS], after_slots[MAX_SLOTS];
+   int differences = 0;
+
+   if (!load_trace(before_path, &before) || !load_trace(after_path, &after))
+   {
+      return 2;
+   }
+
+   if (before.frame_count != after.frame_count)
+   {
+      printf("frame count: %d -> %d\n", before.frame_count, after.frame_count);
+      differences++;
+   }
+
+   int frames = before.frame_count < after.frame_count ? before.frame_count : after.frame_count;
+
+   for (int f = 0; f < frames; f++)
+   {
+      summarize_frame(&before.frames[f], before_slots);
+      summarize_frame(&after.frames[f], after_slots);
+
+      for (int s = MAX_SLOTS - 1; s >= 0; s--)
+      {
+         const SlotSummary *a = &before_slots[s];
+         const SlotSummary *b = &after_slots[s];
+
+         if (!memcmp(a, b, sizeof(*a)))
+         {
+            continue;
+         }
+
+         differences++;
+         printf("frame %d slot %2d: packets %u -> %u (%+d), bytes %u -> %u (%+d),",
+                f, s, (unsigned)a->packets, (unsigned)b->packets, (int)(b->packets - a->packets),
+                (unsigned)a->bytes, (unsigned)b->bytes, (int)(b->bytes - a->bytes));
+         for (int k = 0; k < KIND_COUNT; k++)
+         {
+            if (a->kinds[k] != b->kinds[k])
+            {
+               printf(" %s %+d", kind_names[k], (int)(b->kinds[k] - a->kinds[k]));
+            }
+         }
+         printf("\n");
+      }
+   }
+
+   printf("%d difference(s)\n", differences);
+
+   free_trace(&before);
+   free_trace(&after);
+   return differences ? 1 : 0;
+}
+
+static void replay_packet(int slot, const uint32_t *words, int length, void *user)
+{
+   (void)slot;
+   (void)user;
+   soft_gpu_execute(words, length);
+}
+
+static int command_replay(const char *path, const char *out_dir, const char *vram_path)
+{
+   static uint8_t rgb[SOFT_GPU_VRAM_WIDTH * SOFT_GPU_VRAM_HEIGHT * 3];
+   Trace trace;
+   char out_path[512];
+
+   if (!load_trace(path, &trace))
+   {
+      return 2;
+   }
+
+   soft_gpu_reset();
+
+   if (vram_path)
+   {
+      int w, h;
+
+      if (!read_png_rgb(vram_path, &w, &h, rgb, sizeof(rgb)) ||
+          w != SOFT_GPU_VRAM_WIDTH || h != SOFT_GPU_VRAM_HEIGHT)
+      {
+         fprintf(stderr, "gpu_trace: %s is not a 1024x512 VRAM dump\n", vram_path);
+         free_trace(&trace);
+         return 2;
+      }
+      soft_gpu_write_rgb(0, 0, w, h, rgb);
+   }
+
+   for (int f = 0; f < trace.frame_count; f++)
+   {
+      const GpuTraceHeader *header = trace.frames[f].header;
+      DRAWENV env;
+      SoftGpuStats stats;
+
+      memset(&env, 0, sizeof(env));
+      setRECT(&env.clip, header->clip[0], header->clip[1], header->clip[2], header->clip[3]);
+      env.ofs[0] = header->ofs[0];
+      env.ofs[1] = header->ofs[1];
+      env.tpage = header->mode & 0xffff;
+      env.dtd = (header->mode >> 16) & 1;
+      env.dfe = (header->mode >> 17) & 1;
+      env.isbg = (header->mode >> 18) & 1;
+      setRGB0(&env, header->background & 0xff, (header->background >> 8) & 0xff, (header->background >> 16) & 0xff);
+
+      soft_gpu_begin(&env, &stats);
+      for_each_packet(&trace.frames[f], replay_packet, NULL);
+
+      soft_gpu_read_rgb(env.clip.x, env.clip.y, env.clip.w, env.clip.h, rgb);
+      snprintf(out_path, sizeof(out_path), "%s/frame_%05d.png", out_dir, f);
+      if (!write_png_rgb(out_path, env.clip.w, env.clip.h, rgb))
+      {
+         fprintf(stderr, "gpu_trace: can't write %s\n", out_path);
+         free_trace(&trace);
+         return 2;
+      }
+
+      printf("frame %d: %u pixels drawn, %u touched, %u estimated GPU cycles -> %s\n", f,
+             (unsigned)stats.pixels_drawn, (unsigned)stats.pixels_touched,
+             (unsigned)stats.estimated_cycles, out_path);
+   }
+
+   free_trace(&trace);
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   if (argc == 3 && !strcmp(argv[1], "info"))
+   {
+      return command_info(argv[2]);
+   }
+   if (argc == 4 && !strcmp(argv[1], "diff"))
+   {
+      return command_diff(argv[2], argv[3]);
+   }
+   if ((argc == 4 || argc == 5) && !strcmp(argv[1], "replay"))
+   {
+      return command_replay(argv[2], argv[3], argc == 5 ? argv[4] : NULL);
+   }
+
+   fprintf(stderr, "usage: gpu_trace info <trace>\n"
+                   "       gpu_trace diff <before> <after>\n"
+                   "       gpu_trace replay <trace> <out_dir> [vram.png]\n");
+   return 2;
+}
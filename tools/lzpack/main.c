@@ -0,0 +1,371 @@
+/**
+ * @file main.c
+ * @brief Host packer for LZ compressed assets, see src/libs/lz.c
+ *
+ * Usage:
+ *   lzpack pack <input> <output>
+ *       Packs a file, checks that it unpacks in place and prints the buffer
+ *       size asset_loader.c needs for it: "<input>: <size> -> <packed>
+ *       bytes, buffer <bytes>"
+ *   lzpack bench <packed> [iterations]
+ *       Unpacks a packed file over and over and reports the throughput
+ *
+ * tools/parcel runs it on every TIM that goes on the disc. Build with
+ * `make lzpack`.
+ *
+ * @author marconvcm
+ * @date Current
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../src/libs/lz.h"
+
+#define SECTOR_SIZE 2048
+
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+#define MAX_CHAIN 256
+#define NO_POSITION 0xffffffffu
+
+// Output of the packer, grown as needed
+typedef struct
+{
+   uint8_t *data;
+   size_t length;
+   size_t capacity;
+} Buffer;
+
+static void put_byte(Buffer *buffer, uint8_t value)
+{
+   if (buffer->length == buffer->capacity)
+   {
+      buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+      buffer->data = realloc(buffer->data, buffer->capacity);
+   }
+   buffer->data[buffer->length++] = value;
+}
+
+static void put_length(Buffer *buffer, size_t extra)
+{
+   while (extra >= 255)
+   {
+      put_byte(buffer, 255);
+      extra -= 255;
+   }
+   put_byte(buffer, (uint8_t)extra);
+}
+
+static void put_sequence(Buffer *buffer, const uint8_t *literals, size_t literal_count,
+                         size_t offset, size_t match_length)
+{
+   size_t match_code = match_length ? match_length - LZ_MIN_MATCH : 0;
+   uint8_t token = (uint8_t)(((literal_count < 15 ? literal_count : 15) << 4) |
+                             (match_code < 15 ? match_code : 15));
+
+   put_byte(buffer, token);
+   if (literal_count >= 15)
+   {
+      put_length(buffer, literal_count - 15);
+   }
+   for (size_t i = 0; i < literal_count; i++)
+   {
+      put_byte(buffer, literals[i]);
+   }
+
+   if (match_length)
+   {
+      put_byte(buffer, (uint8_t)offset);
+      put_byte(buffer, (uint8_t)(offset >> 8));
+      if (match_code >= 15)
+      {
+         put_length(buffer, match_code - 15);
+      }
+   }
+}
+
+static uint32_t hash4(const uint8_t *p)
+{
+   uint32_t value = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+   return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Greedy LZ77 with hash chains
+static void pack(const uint8_t *input, size_t size, Buffer *output)
+{
+   uint32_t *head = malloc(HASH_SIZE * sizeof(uint32_t));
+   uint32_t *chain = malloc((size ? size : 1) * sizeof(uint32_t));
+   size_t literal_start = 0;
+   size_t position = 0;
+
+   memset(head, 0xff, HASH_SIZE * sizeof(uint32_t));
+
+   while (position + LZ_MIN_MATCH <= size)
+   {
+      uint32_t hash = hash4(&input[position]);
+      size_t best_length = 0;
+      size_t best_offset = 0;
+      int steps = 0;
+
+      for (uint32_t candidate = head[hash];
+           candidate != NO_POSITION && position - candidate <= LZ_MAX_OFFSET && steps < MAX_CHAIN;
+           candidate = chain[candidate], steps++)
+      {
+         size_t length = 0;
+
+         while (position + length < size && input[candidate + length] == input[position + length])
+         {
+            length++;
+         }
+         if (length > best_length)
+         {
+            best_length = length;
+            best_offset = position - candidate;
+         }
+      }
+
+      chain[position] = head[hash];
+      head[hash] = (uint32_t)position;
+
+      if (best_length < LZ_MIN_MATCH)
+      {
+         position++;
+         continue;
+      }
+
+      put_sequence(output, &input[literal_start], position - literal_start, best_offset, best_length);
+
+      // Index the positions covered by the match
+      for (size_t i = 1; i < best_length && position + i + LZ_MIN_MATCH <= size; i++)
+      {
+         uint32_t h = hash4(&input[position + i]);
+         chain[position + i] = head[h];
+         head[h] = (uint32_t)(position + i);
+      }
+
+      position += best_length;
+      literal_start = position;
+   }
+
+   // The last sequence carries the remaining literals
+   put_sequence(output, &input[literal_start], size - literal_start, 0, 0);
+
+   free(head);
+   free(chain);
+}
+
+static size_t read_length(const uint8_t **p)
+{
+   size_t total = 0;
+   uint8_t extra;
+
+   do
+   {
+      extra = *(*p)++;
+      total += extra;
+   } while (extra == 255);
+
+   return total;
+}
+
+// Replays the sequences like lz_decode() does and returns how far the output
+// gets ahead of the input, the header included, see LzHeader.margin.
+static uint32_t in_place_margin(const uint8_t *sequences, size_t length)
+{
+   const uint8_t *in = sequences;
+   const uint8_t *end = sequences + length;
+   long out = 0;
+   long margin = 0;
+
+   while (in < end)
+   {
+      uint8_t token = *in++;
+      size_t count = token >> 4;
+
+      if (count == 15)
+      {
+         count += read_length(&in);
+      }
+      in += count;
+      out += count;
+
+      // Last literal written after its input byte was read
+      long ahead = out - (long)(sizeof(LzHeader) + (in - sequences));
+      margin = ahead > margin ? ahead : margin;
+
+      if (in >= end)
+      {
+         break;
+      }
+
+      in += 2;
+      count = (token & 15) + LZ_MIN_MATCH;
+      if ((token & 15) == 15)
+      {
+         count += read_length(&in);
+      }
+      out += count;
+
+      ahead = out - (long)(sizeof(LzHeader) + (in - sequences));
+      margin = ahead > margin ? ahead : margin;
+   }
+
+   return (uint32_t)margin;
+}
+
+static uint8_t *load_file(const char *path, size_t *size)
+{
+   FILE *file = fopen(path, "rb");
+
+   if (!file)
+   {
+      fprintf(stderr, "lzpack: can't open %s\n", path);
+      return NULL;
+   }
+
+   fseek(file, 0, SEEK_END);
+   *size = (size_t)ftell(file);
+   fseek(file, 0, SEEK_SET);
+
+   uint8_t *data = malloc(*size ? *size : 1);
+   if (fread(data, 1, *size, file) != *size)
+   {
+      fprintf(stderr, "lzpack: can't read %s\n", path);
+      free(data);
+      data = NULL;
+   }
+   fclose(file);
+
+   return data;
+}
+
+// Checks the packed file the way the asset loader unpacks it: read into the
+// end of the buffer, whole sectors, then unpacked to the start.
+static bool check_in_place(const uint8_t *packed, size_t packed_length, const uint8_t *input,
+                           size_t size, size_t buffer_size)
+{
+   size_t read_length = (packed_length + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+   uint8_t *buffer = malloc(buffer_size);
+   bool ok;
+
+   memset(buffer, 0xcd, buffer_size);
+   memcpy(&buffer[buffer_size - read_length], packed, packed_length);
+
+   ok = lz_unpack(&buffer[buffer_size - read_length], buffer, buffer_size) && !memcmp(buffer, input, size);
+
+   free(buffer);
+   return ok;
+}
+
+static int command_pack(const char *input_path, const char *output_path)
+{
+   size_t size;
+   uint8_t *input = load_file(input_path, &size);
+   Buffer output = {NULL, 0, 0};
+   LzHeader header;
+
+   if (!input)
+   {
+      return 2;
+   }
+
+   for (size_t i = 0; i < sizeof(header); i++)
+   {
+      put_byte(&output, 0);
+   }
+   pack(input, size, &output);
+
+   header.magic = LZ_MAGIC;
+   header.size = (uint32_t)size;
+   header.packed_size = (uint32_t)(output.length - sizeof(header));
+   header.margin = in_place_margin(&output.data[sizeof(header)], header.packed_size);
+   memcpy(output.data, &header, sizeof(header));
+
+   // Buffer for reading the file into its end and unpacking it to its start
+   size_t read_length = (output.length + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+   size_t buffer_size = header.margin + read_length;
+
+   if (buffer_size < size)
+   {
+      buffer_size = size;
+   }
+   buffer_size = (buffer_size + 3) & ~(size_t)3;
+
+   if (!check_in_place(output.data, output.length, input, size, buffer_size))
+   {
+      fprintf(stderr, "lzpack: %s doesn't unpack in place\n", input_path);
+      return 1;
+   }
+
+   FILE *file = fopen(output_path, "wb");
+   if (!file || fwrite(output.data, 1, output.length, file) != output.length)
+   {
+      fprintf(stderr, "lzpack: can't write %s\n", output_path);
+      return 2;
+   }
+   fclose(file);
+
+   printf("%s: %zu -> %zu bytes, buffer %zu\n", input_path, size, output.length, buffer_size);
+
+   free(input);
+   free(output.data);
+   return 0;
+}
+
+static int command_bench(const char *path, int iterations)
+{
+   size_t length;
+   uint8_t *packed = load_file(path, &length);
+   struct timespec start, end;
+
+   if (!packed)
+   {
+      return 2;
+   }
+   if (length < sizeof(LzHeader) || !lz_is_packed(packed))
+   {
+      fprintf(stderr, "lzpack: %s isn't packed\n", path);
+      return 2;
+   }
+
+   size_t size = ((const LzHeader *)packed)->size;
+   uint8_t *output = malloc(size ? size : 1);
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (int i = 0; i < iterations; i++)
+   {
+      if (!lz_unpack(packed, output, size))
+      {
+         fprintf(stderr, "lzpack: %s is corrupt\n", path);
+         return 1;
+      }
+   }
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   double seconds = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+   double bytes = (double)size * iterations;
+
+   printf("%s: %zu -> %zu bytes (%.1f%%), %d x in %.3f s, %.1f MB/s\n", path, length, size,
+          size ? 100.0 * length / size : 0.0, iterations, seconds, seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+
+   free(packed);
+   free(output);
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   if (argc == 4 && !strcmp(argv[1], "pack"))
+   {
+      return command_pack(argv[2], argv[3]);
+   }
+   if ((argc == 3 || argc == 4) && !strcmp(argv[1], "bench"))
+   {
+      return command_bench(argv[2], argc == 4 ? atoi(argv[3]) : 1000);
+   }
+
+   fprintf(stderr, "usage: lzpack pack <input> <output>\n"
+                   "       lzpack bench <packed> [iterations]\n");
+   return 2;
+}
@@ -1,11 +1,17 @@
 #!/usr/bin/env ruby
 
-# Script to update CMakeLists.txt with TIM file entries
+# Script to update CMakeLists.txt and iso.xml with TIM file entries
 # 
 # This script:
-# 1. Finds all .tim files in the assets directory
+# 1. Finds all .tim files in the assets/boot directory, needed at boot
 # 2. Updates the CMakeLists.txt by adding psn00bsdk_target_incbin entries
-#    between the #region images and #endregion markers
+#    for them between the #region images and #endregion markers
+# 3. Updates the host build's src/libs/host/assets.S the same way
+# 4. Packs every .tim file of the assets directory with tools/lzpack and puts
+#    the packed files on the disc, in the ASSETS directory of iso.xml (between
+#    the region assets/endregion comments), for the asset loader to read at
+#    runtime
+# 5. Writes their disc paths and buffer sizes to assets/assets.h
 
 require 'fileutils'
 
@@ -16,17 +22,21 @@ $project_root = File.expand_path('..', $tools_root)
 $src_dir = File.join($project_root, 'src')
 $assets_dir = File.join($src_dir, 'assets')
 $assets_file = File.join($assets_dir, 'assets.h')
+$boot_assets_dir = File.join($assets_dir, 'boot')
 $cmake_file = File.join($src_dir, 'CMakeLists.txt')
+$iso_file = File.join($src_dir, 'iso.xml')
+$lzpack = File.join($project_root, 'out', 'host', 'lzpack')
+$host_assets_file = File.join($src_dir, 'libs', 'host', 'assets.S')
 
 def parcel_tim_files
    cmake_file = $cmake_file
-   # Find all .tim files in the assets directory
-   tim_files = Dir.glob(File.join($assets_dir, '*.tim')).map do |file|
+   # Find all .tim files in the boot assets directory
+   tim_files = Dir.glob(File.join($boot_assets_dir, '*.tim')).sort.map do |file|
    # Get the relative path from the CMakeLists.txt file location
-   File.join('assets', File.basename(file))
+   File.join('assets', 'boot', File.basename(file))
    end
 
-   puts "Found #{tim_files.length} TIM files:"
+   puts "Found #{tim_files.length} boot TIM files:"
    tim_files.each { |file| puts "  - #{file}" }
 
    # Read the CMakeLists.txt file
@@ -38,13 +48,13 @@ def parcel_tim_files
       "psn00bsdk_target_incbin(hello_pong PRIVATE tim_#{target_name} #{tim_file})"
    end
 
-   cmake_includes = cmake_includes.join("\n")
+   cmake_includes = cmake_includes.map { |line| "#{line}\n" }.join
 
    # Find the region markers and replace the content between them
    if cmake_content.include?('#region images') && cmake_content.include?('#endregion')
       updated_content = cmake_content.gsub(
          /#region images\n.*?#endregion/m,
-         "#region images\n#{cmake_includes}\n#endregion"
+         "#region images\n#{cmake_includes}#endregion"
       )
       File.write(cmake_file, updated_content)
       puts "Successfully updated #{cmake_file} with #{tim_files.length} TIM file entries."
@@ -53,10 +63,29 @@ def parcel_tim_files
       exit 1
    end
 
+   # Update the host build's assets.S with the same entries
+   host_includes = tim_files.map do |tim_file|
+      target_name = File.basename(tim_file, '.tim')
+      "incbin_asset tim_#{target_name}, \"#{tim_file}\""
+   end
+
+   host_content = File.read($host_assets_file)
+   if host_content.include?('//region images') && host_content.include?('//endregion')
+      updated_content = host_content.gsub(
+         /\/\/region images\n.*?\/\/endregion/m,
+         "//region images\n#{host_includes.map { |line| "#{line}\n" }.join}//endregion"
+      )
+      File.write($host_assets_file, updated_content)
+      puts "Successfully updated #{$host_assets_file} with #{tim_files.length} TIM file entries."
+   else
+      puts "Error: Could not find the region markers (//region images and //endregion) in #{$host_assets_file}"
+      exit 1
+   end
+
    # Update assets.h with the TIM file entries
    tim_entries = tim_files.map do |tim_file|
       target_name = File.basename(tim_file, '.tim')
-      "extern u_long tim_#{target_name}[];\n"
+      "extern uint32_t tim_#{target_name}[];\n"
    end
 
    puts "Include TIM file entries in main.c: \n"
@@ -65,4 +94,73 @@ def parcel_tim_files
    puts "// endregion "
 end
 
-parcel_tim_files if __FILE__ == $0
\ No newline at end of file
+# 8.3 name of an asset on the disc
+def disc_name(file)
+   File.basename(file, '.tim').upcase.gsub(/[^A-Z0-9_]/, '_')[0, 8] + '.TLZ'
+end
+
+# Packs a TIM with tools/lzpack and returns the buffer size it needs
+def pack_tim(tim_file, packed_file)
+   output = `#{$lzpack} pack "#{tim_file}" "#{packed_file}"`
+   match = output.match(/buffer (\d+)/)
+   unless $?.success? && match
+      puts "Error: lzpack failed on #{tim_file} (run 'make lzpack' first)"
+      exit 1
+   end
+   puts "  #{output.strip}"
+   match[1].to_i
+end
+
+def parcel_disc_files
+   tim_files = Dir.glob(File.join($assets_dir, '*.tim')).sort
+
+   puts "Found #{tim_files.length} disc TIM files:"
+   names = {}
+   entries = []
+   defines = []
+   tim_files.each do |file|
+      base = File.basename(file, '.tim')
+      name = disc_name(file)
+      if names.key?(name)
+         puts "Error: #{File.basename(file)} and #{names[name]} are both #{name} on the disc"
+         exit 1
+      end
+      names[name] = File.basename(file)
+      puts "  - #{File.basename(file)} -> \\ASSETS\\#{name}"
+
+      buffer_size = pack_tim(file, File.join($assets_dir, "#{base}.tlz"))
+      macro = "ASSET_#{base.upcase.gsub(/[^A-Z0-9_]/, '_')}"
+
+      entries << "\t\t\t\t<file name=\"#{name}\" type=\"data\" source=\"${PROJECT_SOURCE_DIR}/assets/#{base}.tlz\" />\n"
+      defines << "#define #{macro} \"\\\\ASSETS\\\\#{name};1\"\n#define #{macro}_BUFFER_SIZE #{buffer_size}\n"
+   end
+
+   iso_content = File.read($iso_file)
+   if iso_content.include?('<!-- region assets -->') && iso_content.include?('<!-- endregion -->')
+      updated_content = iso_content.gsub(
+         /<!-- region assets -->\n.*?<!-- endregion -->/m,
+         "<!-- region assets -->\n\t\t\t<dir name=\"ASSETS\">\n#{entries.join}\t\t\t</dir>\n\t\t\t<!-- endregion -->"
+      )
+      File.write($iso_file, updated_content)
+      puts "Successfully updated #{$iso_file} with #{tim_files.length} TIM file entries."
+   else
+      puts "Error: Could not find the region markers (<!-- region assets --> and <!-- endregion -->) in #{$iso_file}"
+      exit 1
+   end
+
+   File.write($assets_file, <<~HEADER)
+      // Generated by tools/parcel: the disc path of every packed asset and the
+      // buffer size, in bytes, request_packed_asset() needs to read and unpack it.
+      #ifndef ASSETS_H
+      #define ASSETS_H
+
+      #{defines.join("\n")}
+      #endif // ASSETS_H
+   HEADER
+   puts "Successfully updated #{$assets_file}."
+end
+
+if __FILE__ == $0
+   parcel_tim_files
+   parcel_disc_files
+end
\ No newline at end of file